@@ -0,0 +1,128 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include <xc.h>
+
+#include "canlib.h"
+
+#include "can_tx.h"
+#include "timebase.h"
+
+#define GAP_TICKS ((uint16_t)((uint32_t)CAN_TX_MIN_GAP_us * TIMEBASE_TICKS_PER_ms / 1000))
+
+static volatile uint16_t overwritten = 0;
+
+#if CAN_TX_MAILBOX
+// Written by the main loop with interrupts off, sent from the interrupt handler
+static struct {
+    can_msg_t msg;
+    volatile bool full;
+} slots[CAN_TX_SLOTS];
+
+// The last frame loaded came from a slot, so the FIFO goes next
+static bool last_from_slot = false;
+
+// Loads the lowest full slot. False if they're all empty.
+static bool send_slot(void) {
+    for (uint8_t i = 0; i < CAN_TX_SLOTS; i++) {
+        if (slots[i].full) {
+            can_send(&slots[i].msg);
+            slots[i].full = false;
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+// Loads the next frame into TXB0. Slots and the FIFO take turns, so that under saturation
+// neither shuts the other out.
+static void send_next(void) {
+#if CAN_TX_MAILBOX
+    if (last_from_slot) {
+        txb_heartbeat();
+        if (!can_send_rdy()) {
+            last_from_slot = false;
+            return;
+        }
+    }
+    if (send_slot()) {
+        last_from_slot = true;
+        return;
+    }
+    last_from_slot = false;
+#endif
+    txb_heartbeat();
+}
+
+void can_tx_init(void) {
+#if CAN_TX_MAILBOX
+    memset(slots, 0, sizeof(slots));
+    last_from_slot = false;
+#endif
+
+    // CCP3 compares against Timer1, and only interrupts while a gap is running. The toggled
+    // output isn't routed to a pin.
+    CCPTMRS0bits.C3TSEL = 0b01;
+    CCP3CONbits.MODE = 0b0010;
+    CCP3CONbits.EN = 1;
+    PIE4bits.CCP3IE = 0;
+
+    PIR5bits.TXB0IF = 0;
+    PIE5bits.TXB0IE = 1;
+}
+
+void can_tx_handle_tx_interrupt(void) {
+#if CAN_TX_MIN_GAP_us > 0
+    CCPR3 = TMR1 + GAP_TICKS;
+    PIR4bits.CCP3IF = 0;
+    PIE4bits.CCP3IE = 1;
+#else
+    send_next();
+#endif
+}
+
+void can_tx_handle_gap_interrupt(void) {
+    PIE4bits.CCP3IE = 0;
+    send_next();
+}
+
+bool can_tx_enqueue(const can_msg_t *msg) {
+    bool gie = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    bool queued = txb_enqueue(msg);
+    INTCON0bits.GIE = gie;
+    return queued;
+}
+
+void can_tx_post(can_tx_slot slot, const can_msg_t *msg) {
+#if CAN_TX_MAILBOX
+    bool gie = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    if (slots[slot].full) {
+        overwritten++;
+    }
+    slots[slot].msg = *msg;
+    slots[slot].full = true;
+    INTCON0bits.GIE = gie;
+#else
+    if (!can_tx_enqueue(msg)) {
+        overwritten++;
+    }
+#endif
+}
+
+uint16_t can_tx_overwritten(void) {
+    return overwritten;
+}
+
+void can_tx_heartbeat(void) {
+    bool gie = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    // Idle is TXB0 empty with no gap running and no interrupt about to start one. Anything else
+    // ends in an interrupt that loads the next frame.
+    if (can_send_rdy() && !PIR5bits.TXB0IF && !PIE4bits.CCP3IE) {
+        send_next();
+    }
+    INTCON0bits.GIE = gie;
+}
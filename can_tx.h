@@ -0,0 +1,67 @@
+#ifndef CAN_TX_H
+#define CAN_TX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "canlib.h"
+
+// Paces frames from canlib's transmit buffer onto the bus. Each time TXB0 empties its interrupt
+// loads the next frame, after a gap timed by CCP3 against Timer1, so frames leave as soon as the
+// bus and the gap allow rather than when the main loop next comes round. canlib's can_send()
+// only ever uses TXB0.
+
+// Least time from one frame going out to the next being loaded, for receivers that can't keep up
+// with frames back to back. Nominal, so up to 2% out with HFINTOSC. Define as 0 to load the next
+// frame straight from the interrupt.
+#ifndef CAN_TX_MIN_GAP_us
+#define CAN_TX_MIN_GAP_us 250
+#endif
+
+// GPS messages go through latest-value slots, one per message type, instead of canlib's FIFO. A
+// frame posted to a slot replaces any still waiting there, so a congested bus drops stale fixes
+// rather than sending them late, and what's waiting to go stays bounded. Define as 0 to send
+// them through the FIFO with everything else.
+#ifndef CAN_TX_MAILBOX
+#define CAN_TX_MAILBOX 1
+#endif
+
+// Slots are sent lowest first, so a fix goes out in the order it's posted
+typedef enum {
+    CAN_TX_SLOT_GPS_TIME = 0,
+    CAN_TX_SLOT_GPS_LAT,
+    CAN_TX_SLOT_GPS_LON,
+    CAN_TX_SLOT_GPS_INFO,
+    CAN_TX_SLOT_GPS_ALT,
+    CAN_TX_SLOT_GPS_VELOCITY,
+    CAN_TX_SLOT_GPS_CONSTELLATION,
+    CAN_TX_SLOT_GPS_CLOCK,
+    CAN_TX_SLOTS,
+} can_tx_slot;
+
+// Enables the TXB0 interrupt and sets up CCP3. Called after txb_init() and timebase_init().
+void can_tx_init(void);
+
+// Called from the interrupt handler when TXB0 has sent its frame
+void can_tx_handle_tx_interrupt(void);
+
+// Called from the interrupt handler when CCP3 matches, at the end of the gap
+void can_tx_handle_gap_interrupt(void);
+
+// Enqueues a frame on canlib's transmit FIFO with interrupts off, as the TXB0 and CCP3 interrupts
+// take frames off it. Everything outside the interrupt handler enqueues through this rather than
+// txb_enqueue(). False if the FIFO is full.
+bool can_tx_enqueue(const can_msg_t *msg);
+
+// Sends a GPS message through its slot, or with CAN_TX_MAILBOX 0 enqueues it with can_tx_enqueue()
+void can_tx_post(can_tx_slot slot, const can_msg_t *msg);
+
+// Frames replaced in their slot before they were sent, or with CAN_TX_MAILBOX 0 dropped by a full
+// transmit buffer, since boot. Wraps around.
+uint16_t can_tx_overwritten(void);
+
+// Starts sending when the transmitter is idle, as the first frame after a quiet spell has nothing
+// to interrupt it. Called from the main loop.
+void can_tx_heartbeat(void);
+
+#endif /* CAN_TX_H */
@@ -1,26 +1,222 @@
+#include <xc.h>
+
 #include "canlib.h"
-#include "timer.h"
 
 #include "mcc_generated_files/adcc.h"
 #include "mcc_generated_files/fvr.h"
 
+#include "can_tx.h"
 #include "error_checks.h"
+#include "timebase.h"
+
+// The 2.048 V FVR reference makes a count 0.5 mV, and the sense amplifier gives 20 mV per mA
+#define COUNTS_PER_mA 40
+#define OVERCURRENT_THRESHOLD_COUNTS (OVERCURRENT_THRESHOLD_mA * COUNTS_PER_mA)
+// Supply voltage is the FVR measured against VDD, so VDD is FVR_mV * full scale / counts
+#define FVR_mV 2048UL
+#define FULL_SCALE_COUNTS 4096UL
+// FVR counts against VDD at or below this would put VDD past what fits in 16 bits of mV
+#define FVR_COUNTS_MIN ((FVR_mV * FULL_SCALE_COUNTS << FILTER_FRAC_BITS) / UINT16_MAX)
+
+// Filtered values are kept as counts times 8
+#define FILTER_FRAC_BITS 3
+
+// ADCON2.ADMD, ADCON3.ADTMD and ADREF.ADPREF settings, see the ADCC chapter of the datasheet
+#define ADMD_BURST_AVERAGE 0b011
+#define ADTMD_ALWAYS 0b111 // ADTIF at the end of every burst, whatever the threshold test says
+#define ADPREF_VDD 0b00
+#define ADPREF_FVR 0b11
+
+// The temperature indicator needs a long acquisition after a channel change. In ADCRC periods,
+// about 1.7 us each, before every conversion.
+#define ACQUISITION_TAD 32
+
+#if CURRENT_SENSE_SAMPLES == 1
+#define CURRENT_SENSE_SHIFT 0
+#elif CURRENT_SENSE_SAMPLES == 2
+#define CURRENT_SENSE_SHIFT 1
+#elif CURRENT_SENSE_SAMPLES == 4
+#define CURRENT_SENSE_SHIFT 2
+#elif CURRENT_SENSE_SAMPLES == 8
+#define CURRENT_SENSE_SHIFT 3
+#elif CURRENT_SENSE_SAMPLES == 16
+#define CURRENT_SENSE_SHIFT 4
+#elif CURRENT_SENSE_SAMPLES == 32
+#define CURRENT_SENSE_SHIFT 5
+#elif CURRENT_SENSE_SAMPLES == 64
+#define CURRENT_SENSE_SHIFT 6
+#elif CURRENT_SENSE_SAMPLES == 128
+#define CURRENT_SENSE_SHIFT 7
+#else
+#error "CURRENT_SENSE_SAMPLES must be a power of two up to 128"
+#endif
+
+// Bursts in the order they're taken. Current comes round every other burst so an overcurrent is
+// seen within about two bursts, 2.5 ms with the defaults.
+//
+// The temperature indicator puts out about VDD - 2 Vt in its low range, 2.0 to 2.2 V from a 3.3 V
+// supply, which would clip against the 2.048 V FVR. It's measured against VDD instead, along with
+// the FVR, so the indicator's voltage is its counts * FVR_mV / the FVR's counts whatever VDD is.
+static const struct {
+    adcc_channel_t channel;
+    uint8_t adpref;
+    gps_telemetry_channel telemetry;
+} sequence[] = {
+    {channel_CURRENT, ADPREF_FVR, GPS_TELEMETRY_CURRENT},
+    {channel_Temp, ADPREF_VDD, GPS_TELEMETRY_TEMPERATURE},
+    {channel_CURRENT, ADPREF_FVR, GPS_TELEMETRY_CURRENT},
+    {channel_FVR_Buffer1, ADPREF_VDD, GPS_TELEMETRY_VDD},
+};
+#define SEQUENCE_LENGTH (sizeof(sequence) / sizeof(sequence[0]))
+
+static uint8_t step = 0;
+
+// Filtered burst means, counts times 8. Written by the interrupt, each starting from its first
+// mean rather than from 0.
+static volatile uint16_t filtered[GPS_TELEMETRY_ADC_CHANNELS];
+static uint8_t seeded = 0; // a bit per channel
+
+// Set by the interrupt, cleared once check_5v_current_error() has seen it
+static volatile bool overcurrent = false;
+// Already in a board status
+static bool overcurrent_reported = false;
+
+static uint32_t last_current_millis = 0;
+static uint32_t last_board_millis = 0;
+static uint8_t next_board_channel = GPS_TELEMETRY_TEMPERATURE;
 
 //******************************************************************************
 //                              STATUS CHECKS                                 //
 //******************************************************************************
 
-bool check_5v_current_error(void) {
-    adc_result_t sense_raw_mV = ADCC_GetSingleConversion(channel_CURRENT) / 2;
-    int curr_draw_mA = (sense_raw_mV) / 20;
+static void start_burst(void) {
+    ADREFbits.ADPREF = sequence[step].adpref;
+    ADPCH = sequence[step].channel;
+    ADCON0bits.ADGO = 1;
+}
+
+void error_checks_init(void) {
+    ADCC_DisableContinuousConversion();
+    ADCC_StopConversion();
+
+    // Temperature indicator on, in the low range the 3.3 V supply allows
+    FVRCONbits.TSRNG = 0;
+    FVRCONbits.TSEN = 1;
+
+    // ADCRC rather than Fosc, which at 48 MHz is too fast for the converter
+    ADCON0bits.ADCS = 1;
+    ADCC_LoadAcquisitionRegister(ACQUISITION_TAD);
+
+    ADCC_SetRepeatCount(CURRENT_SENSE_SAMPLES);
+    ADCON2bits.ADCRS = CURRENT_SENSE_SHIFT;
+    ADCON2bits.ADMD = ADMD_BURST_AVERAGE;
+    ADCON3bits.ADTMD = ADTMD_ALWAYS;
+
+    PIR1bits.ADTIF = 0;
+    PIE1bits.ADTIE = 1;
+
+    step = 0;
+    start_burst();
+}
+
+void error_checks_handle_adc_interrupt(void) {
+    // The converter is stopped until the next burst is started, so ADFLTR is steady
+    uint16_t mean = ADCC_GetFilterValue();
+    gps_telemetry_channel telemetry = sequence[step].telemetry;
+
+    if (telemetry == GPS_TELEMETRY_CURRENT && mean > OVERCURRENT_THRESHOLD_COUNTS) {
+        overcurrent = true;
+    }
+
+    if (seeded & (1 << telemetry)) {
+        // Both are below 2^15, so the difference fits
+        int16_t error = (int16_t)(mean << FILTER_FRAC_BITS) - (int16_t)filtered[telemetry];
+        filtered[telemetry] += error >> TELEMETRY_FILTER_SHIFT;
+    } else {
+        filtered[telemetry] = mean << FILTER_FRAC_BITS;
+        seeded |= 1 << telemetry;
+    }
 
-    can_msg_t msg;
-    build_analog_data_msg(PRIO_LOW, millis(), SENSOR_5V_CURR, curr_draw_mA, &msg);
-    txb_enqueue(&msg);
+    if (++step == SEQUENCE_LENGTH) {
+        step = 0;
+    }
+    start_burst();
+}
 
-    if (curr_draw_mA > OVERCURRENT_THRESHOLD_mA) {
-        return true;
+uint16_t error_checks_telemetry(gps_telemetry_channel channel) {
+    bool gie = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    uint16_t value = filtered[channel];
+    uint16_t fvr = filtered[GPS_TELEMETRY_VDD];
+    INTCON0bits.GIE = gie;
+
+    switch (channel) {
+        case GPS_TELEMETRY_CURRENT:
+            return value / (COUNTS_PER_mA << FILTER_FRAC_BITS);
+        case GPS_TELEMETRY_TEMPERATURE:
+            // Needs the FVR burst to scale it
+            if (fvr <= FVR_COUNTS_MIN) {
+                return 0;
+            }
+            // Both are counts times 8 against VDD, so that cancels, and 10 makes it 0.1 mV. At most
+            // VDD, which fits below 6.5 V.
+            return (uint32_t)value * (FVR_mV * 10) / fvr;
+        case GPS_TELEMETRY_VDD:
+            // Not measured yet, or a supply far below what the board runs on
+            if (fvr <= FVR_COUNTS_MIN) {
+                return 0;
+            }
+            return (FVR_mV * FULL_SCALE_COUNTS << FILTER_FRAC_BITS) / fvr;
+        default:
+            return 0;
     }
+}
+
+void error_checks_heartbeat(void) {
+    if (overcurrent && !overcurrent_reported) {
+        can_msg_t board_stat_msg;
+        build_general_board_status_msg(
+            PRIO_HIGH, millis(), 1UL << E_5V_OVER_CURRENT_OFFSET, 0, &board_stat_msg
+        );
+        can_tx_enqueue(&board_stat_msg);
+        overcurrent_reported = true;
+    }
+
+    if (millis() - last_current_millis >= CURRENT_TELEMETRY_ms) {
+        can_msg_t msg;
+        build_analog_data_msg(
+            PRIO_LOW, millis(), SENSOR_5V_CURR, error_checks_telemetry(GPS_TELEMETRY_CURRENT),
+            &msg
+        );
+        can_tx_enqueue(&msg);
+        last_current_millis = millis();
+    }
+
+    // The rest one at a time, spread over the period
+    if (millis() - last_board_millis >= BOARD_TELEMETRY_ms / (GPS_TELEMETRY_ADC_CHANNELS - 1)) {
+        can_msg_t msg;
+        build_gps_board_telemetry_msg(
+            PRIO_LOW, millis(), next_board_channel, error_checks_telemetry(next_board_channel),
+            &msg
+        );
+        can_tx_enqueue(&msg);
+        if (++next_board_channel == GPS_TELEMETRY_ADC_CHANNELS) {
+            next_board_channel = GPS_TELEMETRY_TEMPERATURE;
+        }
+        last_board_millis = millis();
+    }
+}
+
+bool check_5v_current_error(void) {
+    bool gie = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    bool latched = overcurrent;
+    overcurrent = false;
+    INTCON0bits.GIE = gie;
 
-    return false;
+    bool error = latched
+                 || error_checks_telemetry(GPS_TELEMETRY_CURRENT) > OVERCURRENT_THRESHOLD_mA;
+    // While it lasts the periodic status carries it, only a new one goes out straight away
+    overcurrent_reported = error;
+    return error;
 }
@@ -2,11 +2,51 @@
 #define ERROR_CHECKS_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "gps_msgs.h"
 
 // From 5V bus line. At this current, a warning will be sent out over CAN
 #define OVERCURRENT_THRESHOLD_mA 100
 
-// General board status checkers
+// The ADCC samples the 5V current, die temperature and supply voltage in turn, in bursts of this
+// many conversions averaged in burst average mode. Its interrupt at the end of each burst moves
+// on to the next channel, so the main loop never waits on a conversion. A power of two up to 128,
+// so the mean is a shift.
+#ifndef CURRENT_SENSE_SAMPLES
+#define CURRENT_SENSE_SAMPLES 16
+#endif
+
+// Each burst's mean goes into the telemetry table through a first order low pass filter that
+// takes 1 / 2^this of each new mean
+#ifndef TELEMETRY_FILTER_SHIFT
+#define TELEMETRY_FILTER_SHIFT 2
+#endif
+
+// How often the filtered current goes out over CAN
+#ifndef CURRENT_TELEMETRY_ms
+#define CURRENT_TELEMETRY_ms 500
+#endif
+
+// How often the slower moving temperature and supply voltage go out
+#ifndef BOARD_TELEMETRY_ms
+#define BOARD_TELEMETRY_ms 5000
+#endif
+
+// Sets the ADCC sequence going. Called after ADCC_Initialize() and FVR_Initialize().
+void error_checks_init(void);
+
+// Called from the interrupt handler when the ADCC has finished a burst
+void error_checks_handle_adc_interrupt(void);
+
+// Sends the telemetry that's due, and a board status straight away after an overcurrent. Called
+// from the main loop.
+void error_checks_heartbeat(void);
+
+// Latest filtered value of a telemetry channel, in its units
+uint16_t error_checks_telemetry(gps_telemetry_channel channel);
+
+// General board status checkers. True if there's been an overcurrent since the last call.
 bool check_5v_current_error(void);
 
 #endif /* ERROR_CHECKS_H */
@@ -0,0 +1,214 @@
+#include "gps_config.h"
+#include "gps_general.h"
+#include "gps_module.h"
+#include "timebase.h"
+#include "ubx.h"
+
+// Long enough to see at least one full epoch at 1 Hz
+#define DETECT_WINDOW_ms 1100
+// Time for the receiver to apply a new port configuration
+#define BAUD_SWITCH_DELAY_ms 100
+#define VERIFY_WINDOW_ms 1000
+// Full passes over the candidate baud rates before giving up
+#define MAX_DETECT_PASSES 3
+// Times the receiver is found but does not come up at the new settings before giving up
+#define MAX_CONFIG_ATTEMPTS 3
+
+typedef struct {
+    uint32_t baud;
+    gps_protocol protocol;
+} baud_candidate;
+
+// Tried in order. The configured rate comes first, since that's where a receiver that kept its
+// configuration through a warm reset of this board will be.
+static const baud_candidate candidates[] = {
+    {GPS_CONFIG_BAUD, GPS_DEFAULT_PROTOCOL},
+    {9600, GPS_PROTOCOL_NMEA}, // factory default
+    {38400, GPS_PROTOCOL_NMEA},
+    {57600, GPS_PROTOCOL_NMEA},
+};
+
+#define NUM_CANDIDATES (sizeof(candidates) / sizeof(candidates[0]))
+
+typedef struct {
+    uint8_t msg_class;
+    uint8_t msg_id;
+    uint8_t nmea_rate; // per epoch, 0 = off
+    uint8_t ubx_rate;
+} msg_rate;
+
+// Output we need from the receiver, everything else is turned off to save line time
+static const msg_rate msg_rates[] = {
+    {UBX_CLASS_NMEA, UBX_NMEA_GGA, 1, 0},
+    {UBX_CLASS_NMEA, UBX_NMEA_RMC, 1, 0},
+    {UBX_CLASS_NMEA, UBX_NMEA_VTG, 0, 0},
+    {UBX_CLASS_NMEA, UBX_NMEA_GSA, 0, 0},
+    {UBX_CLASS_NMEA, UBX_NMEA_GSV, 0, 0},
+    {UBX_CLASS_NMEA, UBX_NMEA_GLL, 0, 0},
+    {UBX_CLASS_NAV, UBX_NAV_PVT, 0, 1},
+};
+
+// CFG-PRT
+#define PRT_PORT_UART1 1
+#define PRT_MODE_8N1 0x000008d0UL
+#define PRT_PROTO_UBX 0x0001
+#define PRT_PROTO_NMEA 0x0002
+#define PRT_PAYLOAD_LEN 20
+
+// CFG-RATE
+#define RATE_TIME_REF_GPS 1
+#define RATE_PAYLOAD_LEN 6
+
+static struct {
+    gps_config_state state;
+    uint8_t candidate;
+    uint8_t detected; // candidate the receiver was last found at
+    uint8_t passes;
+    uint8_t attempts;
+    uint32_t baud;
+    uint8_t nav_msg; // next of CFG-RATE and the msg_rates CFG-MSGs to send
+    uint32_t window_start;
+    uint16_t window_messages; // gps_valid_messages() at window_start
+} config;
+
+static void write_le16(uint8_t *p, uint16_t value) {
+    p[0] = value & 0xff;
+    p[1] = value >> 8;
+}
+
+static void write_le32(uint8_t *p, uint32_t value) {
+    write_le16(p, value & 0xffff);
+    write_le16(p + 2, value >> 16);
+}
+
+static void start_window(void) {
+    config.window_start = millis();
+    config.window_messages = gps_valid_messages();
+}
+
+static uint16_t window_messages(void) {
+    return gps_valid_messages() - config.window_messages;
+}
+
+static void listen_at(uint8_t candidate) {
+    config.candidate = candidate;
+    config.baud = candidates[candidate].baud;
+    uart_set_baud(config.baud);
+    gps_set_protocol(candidates[candidate].protocol);
+    start_window();
+}
+
+static void send_port_config(void) {
+    uint8_t payload[PRT_PAYLOAD_LEN] = {0};
+    uint16_t in_proto = PRT_PROTO_UBX | PRT_PROTO_NMEA;
+    uint16_t out_proto = GPS_DEFAULT_PROTOCOL == GPS_PROTOCOL_UBX ? PRT_PROTO_UBX : PRT_PROTO_NMEA;
+
+    payload[0] = PRT_PORT_UART1;
+    write_le32(payload + 4, PRT_MODE_8N1);
+    write_le32(payload + 8, GPS_CONFIG_BAUD);
+    write_le16(payload + 12, in_proto);
+    write_le16(payload + 14, out_proto);
+    ubx_send(UBX_CLASS_CFG, UBX_CFG_PRT, payload, sizeof(payload));
+}
+
+// Sends CFG-RATE, then a CFG-MSG per msg_rates entry, one per call. False once all are sent.
+static bool send_nav_config(void) {
+    if (config.nav_msg == 0) {
+        uint8_t payload[RATE_PAYLOAD_LEN];
+        write_le16(payload, 1000 / GPS_CONFIG_NAV_RATE_HZ); // measurement period, ms
+        write_le16(payload + 2, 1); // one navigation solution per measurement
+        write_le16(payload + 4, RATE_TIME_REF_GPS);
+        ubx_send(UBX_CLASS_CFG, UBX_CFG_RATE, payload, sizeof(payload));
+    } else if (config.nav_msg <= sizeof(msg_rates) / sizeof(msg_rates[0])) {
+        const msg_rate *rate = &msg_rates[config.nav_msg - 1];
+        uint8_t msg[3];
+        msg[0] = rate->msg_class;
+        msg[1] = rate->msg_id;
+        msg[2] = GPS_DEFAULT_PROTOCOL == GPS_PROTOCOL_UBX ? rate->ubx_rate : rate->nmea_rate;
+        ubx_send(UBX_CLASS_CFG, UBX_CFG_MSG, msg, sizeof(msg));
+    } else {
+        return false;
+    }
+    config.nav_msg++;
+    return true;
+}
+
+void gps_config_start(void) {
+    config.passes = 0;
+    config.attempts = 0;
+    config.state = GPS_CONFIG_DETECT;
+    listen_at(0);
+}
+
+void gps_config_heartbeat(void) {
+    switch (config.state) {
+        case GPS_CONFIG_DETECT:
+            if (window_messages() > 0) {
+                // Found it. The receiver takes UBX input on every port by default.
+                config.detected = config.candidate;
+                send_port_config();
+                config.state = GPS_CONFIG_SWITCH_BAUD;
+                start_window();
+            } else if (millis() - config.window_start > DETECT_WINDOW_ms) {
+                if (config.candidate + 1u < NUM_CANDIDATES) {
+                    listen_at(config.candidate + 1);
+                } else if (++config.passes < MAX_DETECT_PASSES) {
+                    listen_at(0);
+                } else {
+                    config.state = GPS_CONFIG_FAILED;
+                    uart_set_baud(UART_DEFAULT_BAUD);
+                    config.baud = UART_DEFAULT_BAUD;
+                    gps_set_protocol(GPS_PROTOCOL_NMEA);
+                }
+            }
+            break;
+
+        case GPS_CONFIG_SWITCH_BAUD:
+            // Don't change our baud rate until CFG-PRT has left the shift register
+            if (uart_tx_done() && millis() - config.window_start > BAUD_SWITCH_DELAY_ms) {
+                config.baud = GPS_CONFIG_BAUD;
+                uart_set_baud(config.baud);
+                gps_set_protocol(GPS_DEFAULT_PROTOCOL);
+                config.nav_msg = 0;
+                config.state = GPS_CONFIG_SEND_NAV;
+            }
+            break;
+
+        case GPS_CONFIG_SEND_NAV:
+            if (!send_nav_config()) {
+                config.state = GPS_CONFIG_VERIFY;
+                start_window();
+            }
+            break;
+
+        case GPS_CONFIG_VERIFY:
+            if (millis() - config.window_start > VERIFY_WINDOW_ms) {
+                // At the configured rate we should see at least one message per epoch, far more
+                // than the receiver sends at its 1 Hz default
+                if (window_messages() >= GPS_CONFIG_NAV_RATE_HZ) {
+                    config.state = GPS_CONFIG_DONE;
+                } else if (++config.attempts < MAX_CONFIG_ATTEMPTS) {
+                    config.state = GPS_CONFIG_DETECT;
+                    listen_at(0);
+                } else {
+                    // Doesn't take our configuration, keep using it as we found it
+                    config.state = GPS_CONFIG_FAILED;
+                    listen_at(config.detected);
+                }
+            }
+            break;
+
+        case GPS_CONFIG_DONE:
+        case GPS_CONFIG_FAILED:
+        default:
+            break;
+    }
+}
+
+gps_config_state gps_config_get_state(void) {
+    return config.state;
+}
+
+uint32_t gps_config_baud(void) {
+    return config.baud;
+}
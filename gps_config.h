@@ -0,0 +1,34 @@
+#ifndef GPS_CONFIG_H
+#define GPS_CONFIG_H
+
+#include <stdint.h>
+
+// What the receiver is switched to at boot. It must be able to carry GGA + RMC at the nav rate:
+// about 150 bytes per epoch, so 1500 B/s at 10 Hz against 11520 B/s of line rate.
+#define GPS_CONFIG_BAUD 115200
+#define GPS_CONFIG_NAV_RATE_HZ 10
+
+typedef enum {
+    GPS_CONFIG_DETECT = 0, // listening for valid traffic at each candidate baud rate
+    GPS_CONFIG_SWITCH_BAUD, // port reconfigured, waiting for it to take effect
+    GPS_CONFIG_SEND_NAV, // sending the nav rate and message rates, one message per heartbeat
+    GPS_CONFIG_VERIFY, // checking traffic arrives at the new baud and rate
+    GPS_CONFIG_DONE,
+    GPS_CONFIG_FAILED, // receiver not found, or did not take the configuration. Left listening
+                       // where it was found, or at the default baud rate.
+} gps_config_state;
+
+// Starts autobaud detection and reconfiguration of the receiver. uart_init() must have run.
+void gps_config_start(void);
+
+// Advances the configuration, called from the main loop. Never blocks for longer than it takes
+// to put one UBX message on the wire: about 29 ms for CFG-PRT at 9600 baud, and about 1 ms for
+// each of the rest at GPS_CONFIG_BAUD.
+void gps_config_heartbeat(void);
+
+gps_config_state gps_config_get_state(void);
+
+// Baud rate the UART is currently running at
+uint32_t gps_config_baud(void);
+
+#endif /* GPS_CONFIG_H */
@@ -1,6 +1,7 @@
 #include <xc.h>
 
 #include "gps_general.h"
+#include "uart_rx.h"
 
 void uart_init(void) {
     // Set Baud Rate Generator to generate baud rate of 9600
@@ -9,22 +10,26 @@ void uart_init(void) {
     U1CON0bits.BRGS = 1;
     U1CON0bits.MODE = 0;
 
-    // _XTAL_FREQ / 9600 / 16 - 1
-    U1BRGH = 0x4;
-    U1BRGL = 0xE1;
+    uart_set_baud(UART_DEFAULT_BAUD);
 
     // Set RX1 to PORT C7
     U1RXPPS = 0b010111;
 
+    // Set TX1 to PORT C6, used to configure the receiver
+    RC6PPS = 0x13;
+    TRISC6 = 0;
+    ANSELC6 = 0;
+
     // Set the ON bit
     //  Bit7=ON, Bit3 = RXBIMD(Receive Break Interrupt Mode Select bit)
     U1CON1 = 0b10001000;
     //  Run on overflow
     U1CON2bits.RUNOVF = 1;
-    // Set U1TXIE to enable interrupt
-    PIE3bits.U1RXIE = 1;
-    // Enable reception by setting RXEN
+    // Received bytes go to the buffer in uart_rx.c, by DMA or by interrupt
+    uart_rx_init();
+    // Enable reception by setting RXEN, and transmission by setting TXEN
     U1CON0bits.RXEN = 1;
+    U1CON0bits.TXEN = 1;
     // Configure RX pin at C7
     LATC7 = 1;
     ANSELC7 = 0;
@@ -33,6 +38,24 @@ void uart_init(void) {
     // End of UART connection setup
 }
 
+void uart_set_baud(uint32_t baud) {
+    // High speed BRG: _XTAL_FREQ / 4 / baud - 1, rounded to the nearest rate
+    uint16_t brg = (_XTAL_FREQ / 4 + baud / 2) / baud - 1;
+    U1BRGH = brg >> 8;
+    U1BRGL = brg & 0xFF;
+}
+
+void uart_write_byte(uint8_t byte) {
+    // Wait for room in the transmit buffer
+    while (!PIR3bits.U1TXIF) {}
+    U1TXB = byte;
+}
+
+bool uart_tx_done(void) {
+    // Transmit shift register empty and nothing left in the buffer
+    return U1ERRIRbits.TXMTIF;
+}
+
 void led_init(void) {
     TRISB1 = 0;
     LED_1_OFF();
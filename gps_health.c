@@ -0,0 +1,52 @@
+#include "canlib.h"
+
+#include "can_tx.h"
+#include "gps_health.h"
+#include "gps_module.h"
+#include "gps_msgs.h"
+#include "timebase.h"
+#include "uart_rx.h"
+
+static uint8_t next_counter = 0;
+
+static uint32_t counter_value(gps_health_counter counter) {
+    uart_rx_stats_t uart;
+    uart_rx_get_stats(&uart);
+    gps_stats_t parser;
+    gps_get_stats(&parser);
+
+    switch (counter) {
+        case GPS_HEALTH_UART_BYTES:
+            return uart.bytes;
+        case GPS_HEALTH_UART_DROPPED:
+            return uart.dropped;
+        case GPS_HEALTH_UART_FIFO_OVERRUNS:
+            return uart.fifo_overruns;
+        case GPS_HEALTH_UART_FRAME_ERRORS:
+            return uart.frame_errors;
+        case GPS_HEALTH_CHECKSUM_ERRORS:
+            return parser.checksum_errors;
+        case GPS_HEALTH_TRUNCATED:
+            return parser.truncated;
+        case GPS_HEALTH_OVERLONG_FIELDS:
+            return parser.overlong_fields;
+        case GPS_HEALTH_TX_OVERWRITTEN:
+            return can_tx_overwritten();
+        case GPS_HEALTH_FRAMING_ERRORS:
+            return parser.framing_errors;
+        default:
+            return parser.seen[counter - GPS_HEALTH_SEEN_GGA];
+    }
+}
+
+void gps_health_publish(void) {
+    for (uint8_t i = 0; i < GPS_HEALTH_PER_STATUS; i++) {
+        can_msg_t msg;
+        build_gps_health_msg(PRIO_LOW, millis(), next_counter, counter_value(next_counter), &msg);
+        can_tx_enqueue(&msg);
+
+        if (++next_counter == GPS_HEALTH_COUNTERS) {
+            next_counter = 0;
+        }
+    }
+}
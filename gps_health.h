@@ -0,0 +1,15 @@
+#ifndef GPS_HEALTH_H
+#define GPS_HEALTH_H
+
+// UART, parser and transmit health counters from uart_rx.c, gps_module.c and can_tx.c, published
+// over CAN as GPS_MSG_HEALTH messages so data loss in flight shows up in the logs
+
+// Counters sent with each board status message. At one status message every
+// MAX_LOOP_TIME_DIFF_ms, all GPS_HEALTH_COUNTERS go out every
+// GPS_HEALTH_COUNTERS / GPS_HEALTH_PER_STATUS * MAX_LOOP_TIME_DIFF_ms, rounded up.
+#define GPS_HEALTH_PER_STATUS 2
+
+// Enqueues the next GPS_HEALTH_PER_STATUS counters, going round all of them in turn
+void gps_health_publish(void);
+
+#endif /* GPS_HEALTH_H */
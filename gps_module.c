@@ -1,63 +1,141 @@
+#include <stddef.h>
 #include <string.h>
 
 #include <xc.h>
 
 #include "canlib.h"
-#include "timer.h"
 
+#include "can_tx.h"
 #include "gps_general.h"
 #include "gps_module.h"
+#include "gps_msgs.h"
+#include "nmea_convert.h"
+#include "pps.h"
+#include "time_sync.h"
+#include "ubx.h"
 
-// Order matters for this enum, matches the order of GPGGA fields
 typedef enum {
     P_IDLE = 0,
     P_MSG_TYPE,
-    P_TIMESTAMP,
-    P_LATITUDE,
-    P_LATITUDE_DIR_NS,
-    P_LONGITUDE,
-    P_LONGITUDE_DIR_EW,
-    P_QUALITY, // Quality Indicator:
-               // 1 = Uncorrected coordinate
-               // 2 = Differentially correct coordinate (e.g., WAAS, DGPS)
-               // 4 = RTK Fix coordinate (centimeter precision)
-               // 5 = RTK Float (decimeter precision.
-               // 6 = Dead reckoning mode
-    P_NUM_SATELLITES,
-    P_HDOP, // horizontal dilution of precision
-    P_ALTITUDE,
-    P_ALTITUDE_UNITS,
-    P_UNDULATION, // geoid-to-ellipsoid separation
-    P_UNDULATION_UNITS,
-    P_AGE,
-    P_DIFF_REF_ID,
+    P_FIELD,
     P_CHECKSUM,
     P_STOP,
 } parser_state;
 
 typedef struct {
-    char msg[10];
+    nmea_coord_t value;
     char dir;
 } parser_coord;
 
+typedef struct {
+    nmea_number_t value;
+    char units;
+} parser_alt;
+
 typedef struct {
     char indicator;
-    char numsat[2];
+    uint8_t numsat;
 } parser_qual;
 
+typedef struct {
+    nmea_number_t speed; // knots
+    nmea_number_t course; // degrees from true north
+    char status; // A = valid, V = warning
+} parser_velocity;
+
+// Destination of every decoded sentence field
+typedef struct {
+    nmea_number_t utc;
+    parser_coord lat;
+    parser_coord lon;
+    parser_qual qual;
+    parser_alt alt;
+    parser_velocity vel;
+    nmea_number_t date; // ddmmyy
+} parser_data;
+
+// How the bytes of one field are decoded into its destination. Returns false if the field is
+// longer than the destination holds.
+typedef bool (*field_decoder)(void *dest, uint8_t byte);
+
+typedef struct {
+    field_decoder decode; // NULL for fields we skip
+    uint8_t offset; // of the destination within parser_data
+} field_desc;
+
+typedef struct {
+    char type[3]; // without the talker ID
+    const field_desc *fields;
+    uint8_t num_fields;
+    void (*complete)(void); // called once the checksum has been verified
+    gps_stats_type stats_type;
+} sentence_desc;
+
 static struct {
     parser_state state;
+    const sentence_desc *sentence;
+    uint8_t field; // index into sentence->fields
+    bool field_overlong; // already counted
     uint8_t checksum;
-    size_t index;
+    uint8_t index;
     char msg_type[5];
-    char utc[10];
-    parser_coord lat;
-    parser_coord lon;
-    parser_qual qual;
-    parser_coord alt;
-    char exp_checksum[2];
+    uint8_t exp_checksum;
+    gnss_constellation constellation;
+    parser_data data;
 } parser;
 
+// All sentences of one epoch (same UTC time) are published with the same timestamp, the time of
+// the epoch going by the PPS edge. VTG isn't decoded: it carries no time, so it can't be placed
+// in an epoch, and RMC has the same speed and course.
+static struct {
+    nmea_number_t utc;
+    uint32_t timestamp;
+    bool velocity_sent; // only publish velocity once per epoch, e.g. for RMC from two talkers
+} epoch;
+
+// Latest fix assembled from NMEA sentences
+static gps_fix_t nmea_fix;
+
+// Date from the latest RMC, for the GPS time of week of the GGA fixes that follow it
+static struct {
+    bool valid;
+    uint8_t weekday; // 0 is Sunday, when the GPS week starts
+    uint32_t second_of_day; // of the RMC
+} nmea_date;
+
+static gps_protocol protocol = GPS_DEFAULT_PROTOCOL;
+static gps_encoding encoding = GPS_DEFAULT_ENCODING;
+
+// Ties the frames of a compact fix together
+static uint8_t fix_seq = 0;
+
+// What the last GPS_MSG_CONSTELLATION said, and when
+static struct {
+    bool valid;
+    gnss_constellation constellation;
+    uint32_t timestamp;
+} constellation_sent;
+
+// Fixes handed from the decoders to assemble_can_msgs(), double buffered so a commit never waits
+// for the reader and the reader only has to copy again if two commits land during its copy.
+// Commit n goes to fix[n & 1], with seq 2n - 1 while it's being written and 2n once it's done.
+typedef struct {
+    gps_fix_t fix[2];
+    uint32_t timestamp[2];
+    volatile uint8_t seq;
+} fix_snapshot;
+
+static fix_snapshot position_snapshot;
+// Positions committed with a fix
+static volatile uint16_t fix_count = 0;
+static fix_snapshot velocity_snapshot;
+// Last commit of each assembled
+static uint8_t position_seen = 0;
+static uint8_t velocity_seen = 0;
+
+static uint16_t nmea_valid_messages = 0;
+static gps_stats_t nmea_stats;
+
 void gps_init(void) {
     // Set port C2 as output pin (~HWR)
     TRISC2 = 0;
@@ -72,32 +150,6 @@ void gps_init(void) {
     TRISC4 = 1;
 }
 
-// converts string to whole number plus 4 decimal places
-void strtodec(char *str, size_t len, uint32_t *whole, uint16_t *decimal) {
-    uint16_t decimal_place = 1000;
-
-    *whole = 0;
-    *decimal = 0;
-
-    char *current = str;
-    while (current < str + len && '0' <= *current && '9' >= *current) {
-        *whole = *whole * 10 + (*current - '0');
-        current++;
-    }
-
-    if (current >= str + len || *current != '.') {
-        return;
-    }
-
-    current++;
-
-    while (decimal_place > 0 && current < str + len && '0' <= *current && '9' >= *current) {
-        *decimal += decimal_place * (*current - '0');
-        decimal_place /= 10;
-        current++;
-    }
-}
-
 // converts a hex char to integer
 uint8_t hextoint(char hex) {
     if ('0' <= hex && hex <= '9') {
@@ -112,128 +164,479 @@ uint8_t hextoint(char hex) {
     return 0;
 }
 
-void enqueue_can_msgs_utc(uint32_t timestamp) {
+static bool decode_number(void *dest, uint8_t byte) {
+    return nmea_number_push((nmea_number_t *)dest, byte);
+}
+
+static bool decode_coord(void *dest, uint8_t byte) {
+    return nmea_coord_push((nmea_coord_t *)dest, byte);
+}
+
+// Single character fields keep their last byte. The parser clears them for every sentence.
+static bool decode_char(void *dest, uint8_t byte) {
+    bool first = *(char *)dest == 0;
+    *(char *)dest = byte;
+    return first;
+}
+
+static bool decode_count(void *dest, uint8_t byte) {
+    if ('0' <= byte && byte <= '9') {
+        uint16_t count = *(uint8_t *)dest * 10 + (byte - '0');
+        if (count > UINT8_MAX) {
+            return false;
+        }
+        *(uint8_t *)dest = count;
+    }
+    return true;
+}
+
+void enqueue_can_msgs_utc(const gps_fix_t *fix, uint32_t timestamp) {
     can_msg_t msg_utc;
 
-    uint32_t utc;
-    uint16_t dsec;
-    strtodec(parser.utc, 10, &utc, &dsec);
-
-    // message format: hhmmss.sss
-    // strtodec returns 4 digits for dsec, so we divide it by 100 to make it fit within a byte.
-    build_gps_time_msg(
-        PRIO_HIGH,
-        timestamp,
-        (uint8_t)(utc / 10000 % 100),
-        (uint8_t)(utc / 100 % 100),
-        (uint8_t)(utc % 100),
-        (uint8_t)(dsec / 100),
-        &msg_utc
-    );
-    txb_enqueue(&msg_utc);
+    // message format: hhmmss.ss
+    build_gps_time_msg(PRIO_HIGH, timestamp, fix->hour, fix->min, fix->sec, fix->csec, &msg_utc);
+    can_tx_post(CAN_TX_SLOT_GPS_TIME, &msg_utc);
 }
 
-void enqueue_can_msgs_lat(uint32_t timestamp) {
+void enqueue_can_msgs_lat(const gps_fix_t *fix, uint32_t timestamp) {
     can_msg_t msg_lat;
 
-    uint32_t lat;
-    uint16_t dmin;
-    strtodec(parser.lat.msg, 10, &lat, &dmin);
-
     // messge format: ddmm.mmmm
     build_gps_lat_msg(
-        PRIO_HIGH,
-        timestamp,
-        (uint8_t)(lat / 100),
-        (uint8_t)(lat % 100),
-        (uint16_t)dmin,
-        parser.lat.dir,
-        &msg_lat
+        PRIO_HIGH, timestamp, fix->lat.deg, fix->lat.min, fix->lat.dmin, fix->lat.dir, &msg_lat
     );
-    txb_enqueue(&msg_lat);
+    can_tx_post(CAN_TX_SLOT_GPS_LAT, &msg_lat);
 }
 
-void enqueue_can_msgs_lon(uint32_t timestamp) {
+void enqueue_can_msgs_lon(const gps_fix_t *fix, uint32_t timestamp) {
     can_msg_t msg_lon;
 
-    uint32_t lon;
-    uint16_t dmin;
-    strtodec(parser.lon.msg, 10, &lon, &dmin);
-
     // message format: dddmm.mmmm
     build_gps_lon_msg(
-        PRIO_HIGH,
-        timestamp,
-        (uint8_t)(lon / 100),
-        (uint8_t)(lon % 100),
-        (uint16_t)dmin,
-        parser.lon.dir,
-        &msg_lon
+        PRIO_HIGH, timestamp, fix->lon.deg, fix->lon.min, fix->lon.dmin, fix->lon.dir, &msg_lon
     );
-    txb_enqueue(&msg_lon);
+    can_tx_post(CAN_TX_SLOT_GPS_LON, &msg_lon);
 }
 
-void enqueue_can_msgs_alt(uint32_t timestamp) {
+void enqueue_can_msgs_alt(const gps_fix_t *fix, uint32_t timestamp) {
     can_msg_t msg_alt;
 
-    uint32_t alt;
-    uint16_t dalt;
-    strtodec(parser.alt.msg, 10, &alt, &dalt);
+    // message format: just a normal decimal number, only the first 2 fractional digits are sent
+    // so that they fit within a byte
+    build_gps_alt_msg(PRIO_HIGH, timestamp, fix->alt, fix->calt, fix->alt_units, &msg_alt);
+    can_tx_post(CAN_TX_SLOT_GPS_ALT, &msg_alt);
+}
+
+void enqueue_can_msgs_info(const gps_fix_t *fix, uint32_t timestamp) {
+    can_msg_t msg_info;
+
+    build_gps_info_msg(PRIO_HIGH, timestamp, fix->numsat, fix->quality, &msg_info);
+    can_tx_post(CAN_TX_SLOT_GPS_INFO, &msg_info);
+}
+
+void enqueue_can_msgs_constellation(const gps_fix_t *fix, uint32_t timestamp) {
+    if (constellation_sent.valid && fix->constellation == constellation_sent.constellation
+        && timestamp - constellation_sent.timestamp < GPS_CONSTELLATION_REPEAT_ms) {
+        return;
+    }
+    constellation_sent.valid = true;
+    constellation_sent.constellation = fix->constellation;
+    constellation_sent.timestamp = timestamp;
+
+    can_msg_t msg_constellation;
+    build_gps_constellation_msg(PRIO_LOW, timestamp, fix->constellation, &msg_constellation);
+    can_tx_post(CAN_TX_SLOT_GPS_CONSTELLATION, &msg_constellation);
+}
+
+void enqueue_can_msgs_vel(const gps_fix_t *fix, uint32_t timestamp) {
+    can_msg_t msg_vel;
+
+    // message format: speed in cm/s, course in hundredths of a degree
+    build_gps_velocity_msg(PRIO_HIGH, timestamp, fix->speed, fix->course, &msg_vel);
+    can_tx_post(CAN_TX_SLOT_GPS_VELOCITY, &msg_vel);
+}
+
+// The compact frames take the slots of the canlib messages they replace
+void enqueue_can_msgs_compact(const gps_fix_t *fix) {
+    can_msg_t msgs[GPS_FIX_FRAMES];
+
+    uint8_t info = (fix->quality & GPS_FIX_INFO_QUALITY_MASK)
+                   | (fix->constellation << GPS_FIX_INFO_CONSTELLATION_SHIFT);
 
-    // message format: just a normal decimal number, we divide decimal part by 100 to make it fit
-    // within a byte
-    build_gps_alt_msg(
-        PRIO_HIGH, millis(), (uint16_t)alt, (uint8_t)(dalt / 100), parser.alt.dir, &msg_alt
+    build_gps_fix_msgs(
+        PRIO_HIGH, fix_seq++, fix->tow, info, fix->numsat, fix->lat_e7, fix->lon_e7, fix->alt_dm,
+        msgs
     );
-    txb_enqueue(&msg_alt);
+    can_tx_post(CAN_TX_SLOT_GPS_TIME, &msgs[0]);
+    can_tx_post(CAN_TX_SLOT_GPS_LAT, &msgs[1]);
+    can_tx_post(CAN_TX_SLOT_GPS_LON, &msgs[2]);
 }
 
-void enqueue_can_msgs_info(uint32_t timestamp) {
-    can_msg_t msg_info;
+static void snapshot_commit(fix_snapshot *snapshot, const gps_fix_t *fix, uint32_t timestamp) {
+    uint8_t next = ((snapshot->seq >> 1) + 1) & 1;
+    snapshot->seq++;
+    snapshot->fix[next] = *fix;
+    snapshot->timestamp[next] = timestamp;
+    snapshot->seq++;
+}
+
+// Copies the latest commit out if it's newer than *seen. Commit n is being overwritten once
+// commit n + 2 starts, at seq 2n + 3.
+static bool snapshot_read(
+    const fix_snapshot *snapshot, uint8_t *seen, gps_fix_t *fix, uint32_t *timestamp
+) {
+    uint8_t commit;
+    do {
+        uint8_t seq = snapshot->seq;
+        commit = seq >> 1;
+        if (commit == *seen) {
+            return false;
+        }
+        *fix = snapshot->fix[commit & 1];
+        *timestamp = snapshot->timestamp[commit & 1];
+    } while ((uint8_t)(snapshot->seq - (commit << 1)) >= 3);
+
+    *seen = commit;
+    return true;
+}
+
+void gps_commit_position(const gps_fix_t *fix, uint32_t timestamp) {
+    snapshot_commit(&position_snapshot, fix, timestamp);
+    // An empty NMEA quality field decodes as something past 9
+    if (fix->quality != 0 && fix->quality <= 9) {
+        fix_count++;
+    }
+}
+
+uint16_t gps_fixes(void) {
+    // Two bytes the interrupt can change half way through reading
+    uint16_t count;
+    do {
+        count = fix_count;
+    } while (count != fix_count);
+    return count;
+}
+
+void gps_commit_velocity(const gps_fix_t *fix, uint32_t timestamp) {
+    snapshot_commit(&velocity_snapshot, fix, timestamp);
+}
+
+static void publish_position(const gps_fix_t *fix, uint32_t timestamp) {
+    if (encoding == GPS_ENCODING_COMPACT) {
+        enqueue_can_msgs_compact(fix);
+    } else {
+        enqueue_can_msgs_utc(fix, timestamp);
+        enqueue_can_msgs_lat(fix, timestamp);
+        enqueue_can_msgs_lon(fix, timestamp);
+        enqueue_can_msgs_info(fix, timestamp);
+        enqueue_can_msgs_alt(fix, timestamp);
+        enqueue_can_msgs_constellation(fix, timestamp);
+    }
 
-    uint8_t numsat = (uint8_t)strtol(parser.qual.numsat, NULL, 10);
-    uint8_t quality = parser.qual.indicator - '0';
+    time_sync_handle_fix(fix, timestamp);
+}
+
+void assemble_can_msgs(void) {
+    gps_fix_t fix;
+    uint32_t timestamp;
+
+    if (snapshot_read(&position_snapshot, &position_seen, &fix, &timestamp)) {
+        publish_position(&fix, timestamp);
+    }
+    if (snapshot_read(&velocity_snapshot, &velocity_seen, &fix, &timestamp)) {
+        enqueue_can_msgs_vel(&fix, timestamp);
+    }
+}
 
-    build_gps_info_msg(PRIO_HIGH, timestamp, numsat, quality, &msg_info);
-    txb_enqueue(&msg_info);
+static void coord_from_nmea(gps_coord_t *coord, const parser_coord *field) {
+    // ddmm.mmmm or dddmm.mmmm
+    coord->deg = (uint8_t)nmea_number_int(&field->value.num, 2, 3);
+    coord->min = (uint8_t)nmea_number_int(&field->value.num, 0, 2);
+    coord->dmin = nmea_number_frac(&field->value.num, 4);
+    coord->dir = field->dir;
+}
+
+// Every digit the receiver gives, where the canlib messages stop at 1e-4 minutes
+static int32_t coord_e7(const parser_coord *field, char neg_dir) {
+    int32_t value = (int32_t)nmea_coord_e7(&field->value);
+    return field->dir == neg_dir ? -value : value;
+}
+
+// Days before each month in a year that isn't a leap year
+static const uint16_t days_before_month[12] = {
+    0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334,
+};
+
+// Day of the week of an RMC date, for years 2000 to 2099
+static uint8_t weekday_from_nmea(const nmea_number_t *date) {
+    uint8_t day = (uint8_t)nmea_number_int(date, 4, 2);
+    uint8_t month = (uint8_t)nmea_number_int(date, 2, 2);
+    uint8_t year = (uint8_t)nmea_number_int(date, 0, 2);
+    if (month < 1 || month > 12) {
+        month = 1;
+    }
+
+    uint16_t days = year * 365U + (year + 3) / 4 + days_before_month[month - 1] + day - 1;
+    if (year % 4 == 0 && month > 2) {
+        days++;
+    }
+    // 1 January 2000 was a Saturday
+    return (days + 6) % 7;
+}
+
+// GPS time of week of a UTC time of day, by the date of the last RMC
+static uint32_t tow_from_nmea(const gps_fix_t *fix) {
+    if (!nmea_date.valid) {
+        return GPS_TOW_UNKNOWN;
+    }
+
+    uint32_t second_of_day = (uint32_t)fix->hour * 3600 + (uint16_t)fix->min * 60 + fix->sec;
+    uint8_t weekday = nmea_date.weekday;
+    // Past midnight since that RMC
+    if (second_of_day < nmea_date.second_of_day) {
+        weekday = (weekday + 1) % 7;
+    }
+
+    uint32_t tow = (weekday * 86400UL + second_of_day + GPS_UTC_LEAP_SECONDS) * 1000
+                   + fix->csec * 10U;
+    return tow % GPS_MS_PER_WEEK;
+}
+
+// Knots to cm/s is 51.4444, applied to centiknots as a multiply by 33715 / 2^16. Does not
+// overflow up to the 655 m/s that fits in the message.
+#define CENTIKNOTS_TO_CM_S_MUL 33715UL
+#define CENTIKNOTS_TO_CM_S_SHIFT 16
+
+static void velocity_from_nmea(gps_fix_t *fix, const parser_velocity *vel) {
+    uint32_t centiknots =
+        (uint32_t)nmea_number_int(&vel->speed, 0, 4) * 100 + nmea_number_frac(&vel->speed, 2);
+    fix->speed = (centiknots * CENTIKNOTS_TO_CM_S_MUL) >> CENTIKNOTS_TO_CM_S_SHIFT;
+    fix->course = nmea_number_int(&vel->course, 0, 3) * 100 + nmea_number_frac(&vel->course, 2);
+}
+
+// Timestamp for a sentence that carries UTC time, starting a new epoch if the time has changed
+static uint32_t epoch_timestamp(void) {
+    if (!nmea_number_equal(&epoch.utc, &parser.data.utc)) {
+        epoch.utc = parser.data.utc;
+        epoch.timestamp = pps_epoch_time(nmea_number_frac(&parser.data.utc, 2) * 10);
+        epoch.velocity_sent = false;
+    }
+    return epoch.timestamp;
+}
+
+static void publish_velocity(void) {
+    if (!epoch.velocity_sent) {
+        velocity_from_nmea(&nmea_fix, &parser.data.vel);
+        gps_commit_velocity(&nmea_fix, epoch.timestamp);
+        epoch.velocity_sent = true;
+    }
+}
+
+static void gga_complete(void) {
+    uint32_t timestamp = epoch_timestamp();
+
+    // hhmmss.ss
+    nmea_fix.hour = (uint8_t)nmea_number_int(&parser.data.utc, 4, 2);
+    nmea_fix.min = (uint8_t)nmea_number_int(&parser.data.utc, 2, 2);
+    nmea_fix.sec = (uint8_t)nmea_number_int(&parser.data.utc, 0, 2);
+    nmea_fix.csec = (uint8_t)nmea_number_frac(&parser.data.utc, 2);
+    coord_from_nmea(&nmea_fix.lat, &parser.data.lat);
+    coord_from_nmea(&nmea_fix.lon, &parser.data.lon);
+    nmea_fix.alt = nmea_number_int(&parser.data.alt.value, 0, NMEA_INT_DIGITS);
+    nmea_fix.calt = (uint8_t)nmea_number_frac(&parser.data.alt.value, 2);
+    nmea_fix.alt_units = parser.data.alt.units;
+    nmea_fix.numsat = parser.data.qual.numsat;
+    nmea_fix.quality = parser.data.qual.indicator - '0';
+    nmea_fix.constellation = parser.constellation;
+
+    nmea_fix.tow = tow_from_nmea(&nmea_fix);
+    nmea_fix.lat_e7 = coord_e7(&parser.data.lat, 'S');
+    nmea_fix.lon_e7 = coord_e7(&parser.data.lon, 'W');
+    nmea_fix.alt_dm = (int32_t)nmea_fix.alt * 10 + nmea_fix.calt / 10;
+
+    gps_commit_position(&nmea_fix, timestamp);
+}
+
+static void rmc_complete(void) {
+    epoch_timestamp();
+    if (parser.data.date.int_count == 6) {
+        nmea_date.weekday = weekday_from_nmea(&parser.data.date);
+        nmea_date.second_of_day = nmea_number_int(&parser.data.utc, 4, 2) * 3600UL
+                                  + nmea_number_int(&parser.data.utc, 2, 2) * 60
+                                  + nmea_number_int(&parser.data.utc, 0, 2);
+        nmea_date.valid = true;
+    }
+    if (parser.data.vel.status == 'A') {
+        publish_velocity();
+    }
+}
+
+// Sentence schemas. Each field list is in sentence order, starting after the type field, and
+// expands through FIELD(decoder, destination in parser_data) or SKIP(name). Fields past the end
+// of a list are skipped.
+//
+// GGA quality indicator:
+// 1 = Uncorrected coordinate
+// 2 = Differentially correct coordinate (e.g., WAAS, DGPS)
+// 4 = RTK Fix coordinate (centimeter precision)
+// 5 = RTK Float (decimeter precision.
+// 6 = Dead reckoning mode
+#define GGA_FIELDS(FIELD, SKIP)                                                                    \
+    FIELD(decode_number, utc)                                                                      \
+    FIELD(decode_coord, lat.value)                                                                 \
+    FIELD(decode_char, lat.dir)                                                                    \
+    FIELD(decode_coord, lon.value)                                                                 \
+    FIELD(decode_char, lon.dir)                                                                    \
+    FIELD(decode_char, qual.indicator)                                                             \
+    FIELD(decode_count, qual.numsat)                                                               \
+    SKIP(hdop)                                                                                     \
+    FIELD(decode_number, alt.value)                                                                \
+    FIELD(decode_char, alt.units)                                                                  \
+    SKIP(undulation)                                                                               \
+    SKIP(undulation_units)                                                                         \
+    SKIP(age)                                                                                      \
+    SKIP(diff_ref_id)
+
+#define RMC_FIELDS(FIELD, SKIP)                                                                    \
+    FIELD(decode_number, utc)                                                                      \
+    FIELD(decode_char, vel.status)                                                                 \
+    SKIP(lat)                                                                                      \
+    SKIP(lat_dir)                                                                                  \
+    SKIP(lon)                                                                                      \
+    SKIP(lon_dir)                                                                                  \
+    FIELD(decode_number, vel.speed)                                                                \
+    FIELD(decode_number, vel.course)                                                               \
+    FIELD(decode_number, date)
+
+#define FIELD_DESC(decoder, dest) {decoder, offsetof(parser_data, dest)},
+#define SKIP_DESC(name) {NULL, 0},
+
+static const field_desc gga_fields[] = {GGA_FIELDS(FIELD_DESC, SKIP_DESC)};
+static const field_desc rmc_fields[] = {RMC_FIELDS(FIELD_DESC, SKIP_DESC)};
+
+// X(type without talker ID, field table, completion handler, what it's counted as)
+#define SENTENCES(X)                                                                               \
+    X("GGA", gga_fields, gga_complete, GPS_STATS_GGA)                                              \
+    X("RMC", rmc_fields, rmc_complete, GPS_STATS_RMC)
+
+#define SENTENCE_DESC(type, fields, complete, stats_type)                                          \
+    {type, fields, sizeof(fields) / sizeof(fields[0]), complete, stats_type},
+
+static const sentence_desc sentences[] = {SENTENCES(SENTENCE_DESC)};
+
+// Looks up the sentence from the type that follows the 2 character talker ID, so every
+// constellation's GGA shares one table entry
+static const sentence_desc *find_sentence(const char *msg_type) {
+    for (uint8_t i = 0; i < sizeof(sentences) / sizeof(sentences[0]); i++) {
+        if (strncmp(msg_type + 2, sentences[i].type, 3) == 0) {
+            return &sentences[i];
+        }
+    }
+    return NULL;
+}
+
+static gnss_constellation find_constellation(const char *msg_type) {
+    if (msg_type[0] == 'B' && msg_type[1] == 'D') {
+        return GNSS_BEIDOU;
+    }
+    if (msg_type[0] != 'G') {
+        return GNSS_UNKNOWN;
+    }
+    switch (msg_type[1]) {
+        case 'P':
+            return GNSS_GPS;
+        case 'L':
+            return GNSS_GLONASS;
+        case 'A':
+            return GNSS_GALILEO;
+        case 'B':
+            return GNSS_BEIDOU;
+        case 'Q':
+            return GNSS_QZSS;
+        case 'N':
+            return GNSS_COMBINED;
+        default:
+            return GNSS_UNKNOWN;
+    }
 }
 
 void reset_parser(void) {
     memset(&parser, 0, sizeof(parser));
 }
 
-void gps_handle_byte(uint8_t byte) {
+void gps_set_protocol(gps_protocol new_protocol) {
+    protocol = new_protocol;
+    reset_parser();
+    ubx_reset();
+    // The receiver has just been configured, so say again what it's using
+    constellation_sent.valid = false;
+}
+
+void gps_set_encoding(gps_encoding new_encoding) {
+    encoding = new_encoding;
+}
+
+uint16_t gps_valid_messages(void) {
+    return nmea_valid_messages + ubx_valid_messages();
+}
+
+void gps_get_stats(gps_stats_t *stats) {
+    *stats = nmea_stats;
+
+    ubx_stats_t ubx;
+    ubx_get_stats(&ubx);
+    stats->seen[GPS_STATS_UBX_NAV_PVT] = ubx.nav_pvt;
+    stats->seen[GPS_STATS_UBX_OTHER] = ubx.other;
+    stats->checksum_errors += ubx.checksum_errors;
+    stats->framing_errors = ubx.framing_errors;
+}
+
+// A sentence we decode that ends before its checksum has lost bytes
+static bool nmea_in_sentence(void) {
+    return parser.state == P_MSG_TYPE || parser.state == P_FIELD
+           || (parser.state == P_CHECKSUM && parser.index < 2);
+}
+
+static void nmea_handle_byte(uint8_t byte) {
     switch (byte) {
         case '$':
             // Start of message
+            if (nmea_in_sentence()) {
+                nmea_stats.truncated++;
+            }
             reset_parser();
             parser.state = P_MSG_TYPE;
             break;
 
         case ',':
             // Field separater
-            if (parser.state == P_IDLE) {
-                break;
-            }
             if (parser.state == P_MSG_TYPE) {
-                if (strncmp(parser.msg_type, "GPGGA", 5) != 0) {
-                    // Not a GPGGA signal, then we don't care
+                parser.sentence = find_sentence(parser.msg_type);
+                if (parser.sentence == NULL) {
+                    // Not a sentence we decode, then we don't care
+                    nmea_stats.seen[GPS_STATS_NMEA_OTHER]++;
                     parser.state = P_STOP;
                     return;
-                } else {
-                    LED_2_ON();
                 }
+                nmea_stats.seen[parser.sentence->stats_type]++;
+                parser.constellation = find_constellation(parser.msg_type);
+                LED_2_ON();
+                parser.state = P_FIELD;
+            } else if (parser.state == P_FIELD) {
+                parser.field++;
+                parser.field_overlong = false;
+            } else {
+                break;
             }
 
-            parser.state++;
             parser.index = 0;
             parser.checksum ^= byte;
 
             break;
 
         case '*':
-            // Checksum indicator
-            if (parser.state == P_IDLE) {
+            // Checksum indicator, only valid after the fields of a sentence we decode
+            if (parser.state != P_FIELD) {
                 break;
             }
             parser.state = P_CHECKSUM;
@@ -243,17 +646,15 @@ void gps_handle_byte(uint8_t byte) {
         case '\r':
         case '\n': {
             // End of message
-            if (parser.state == P_CHECKSUM) {
-                uint8_t exp_checksum =
-                    (hextoint(parser.exp_checksum[0]) << 4) | hextoint(parser.exp_checksum[1]);
-                if (parser.checksum == exp_checksum) {
-                    uint32_t timestamp = millis();
-                    enqueue_can_msgs_utc(timestamp);
-                    enqueue_can_msgs_lat(timestamp);
-                    enqueue_can_msgs_lon(timestamp);
-                    enqueue_can_msgs_info(timestamp);
-                    enqueue_can_msgs_alt(timestamp);
+            if (parser.state == P_CHECKSUM && parser.index == 2) {
+                if (parser.checksum == parser.exp_checksum) {
+                    nmea_valid_messages++;
+                    parser.sentence->complete();
+                } else {
+                    nmea_stats.checksum_errors++;
                 }
+            } else if (nmea_in_sentence()) {
+                nmea_stats.truncated++;
             }
 
             parser.state = P_STOP;
@@ -261,56 +662,31 @@ void gps_handle_byte(uint8_t byte) {
         }
 
         default: {
-// help macro to safely add byte to parser message
-#define APPEND_PARSER_MESSAGE(msg, byte)                                                           \
-    do {                                                                                           \
-        if (parser.index < sizeof(msg))                                                            \
-            msg[parser.index++] = byte;                                                            \
-    } while (0)
-
             // Parse message fields
             switch (parser.state) {
                 case P_IDLE:
                     break;
                 case P_MSG_TYPE:
-                    APPEND_PARSER_MESSAGE(parser.msg_type, byte);
-                    break;
-                case P_TIMESTAMP:
-                    APPEND_PARSER_MESSAGE(parser.utc, byte);
-                    break;
-                case P_LATITUDE:
-                    APPEND_PARSER_MESSAGE(parser.lat.msg, byte);
-                    break;
-                case P_LONGITUDE:
-                    APPEND_PARSER_MESSAGE(parser.lon.msg, byte);
-                    break;
-                case P_LATITUDE_DIR_NS:
-                    parser.lat.dir = byte;
-                    break;
-                case P_LONGITUDE_DIR_EW:
-                    parser.lon.dir = byte;
-                    break;
-                case P_QUALITY:
-                    parser.qual.indicator = byte;
-                    break;
-                case P_NUM_SATELLITES:
-                    APPEND_PARSER_MESSAGE(parser.qual.numsat, byte);
-                    break;
-                case P_HDOP:
-                    break;
-                case P_ALTITUDE:
-                    APPEND_PARSER_MESSAGE(parser.alt.msg, byte);
+                    if (parser.index < sizeof(parser.msg_type)) {
+                        parser.msg_type[parser.index++] = byte;
+                    }
                     break;
-                case P_ALTITUDE_UNITS:
-                    parser.alt.dir = byte;
-                    break;
-                case P_UNDULATION:
-                case P_UNDULATION_UNITS:
-                case P_AGE:
-                case P_DIFF_REF_ID:
+                case P_FIELD:
+                    if (parser.field < parser.sentence->num_fields) {
+                        const field_desc *field = &parser.sentence->fields[parser.field];
+                        if (field->decode
+                            && !field->decode((uint8_t *)&parser.data + field->offset, byte)
+                            && !parser.field_overlong) {
+                            nmea_stats.overlong_fields++;
+                            parser.field_overlong = true;
+                        }
+                    }
                     break;
                 case P_CHECKSUM:
-                    APPEND_PARSER_MESSAGE(parser.exp_checksum, byte);
+                    if (parser.index < 2) {
+                        parser.exp_checksum = (parser.exp_checksum << 4) | hextoint(byte);
+                        parser.index++;
+                    }
                     break;
                 case P_STOP:
                 default:
@@ -327,3 +703,24 @@ void gps_handle_byte(uint8_t byte) {
         }
     }
 }
+
+void gps_handle_byte(uint8_t byte) {
+    if (protocol == GPS_PROTOCOL_UBX) {
+        ubx_handle_byte(byte);
+    } else {
+        nmea_handle_byte(byte);
+    }
+}
+
+void gps_handle_bytes(const uint8_t *data, uint16_t length) {
+    // The protocol only changes from the main loop, so pick the parser once per chunk
+    if (protocol == GPS_PROTOCOL_UBX) {
+        for (uint16_t i = 0; i < length; i++) {
+            ubx_handle_byte(data[i]);
+        }
+    } else {
+        for (uint16_t i = 0; i < length; i++) {
+            nmea_handle_byte(data[i]);
+        }
+    }
+}
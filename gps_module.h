@@ -3,10 +3,133 @@
 
 #include <stdint.h>
 
+// Constellation the receiver computed the fix from, taken from the NMEA talker ID. canlib's info
+// message has no room for it, so with that encoding it goes out as GPS_MSG_CONSTELLATION.
+typedef enum {
+    GNSS_UNKNOWN = 0,
+    GNSS_GPS, // GP
+    GNSS_GLONASS, // GL
+    GNSS_GALILEO, // GA
+    GNSS_BEIDOU, // GB or BD
+    GNSS_QZSS, // GQ
+    GNSS_COMBINED, // GN, more than one constellation
+} gnss_constellation;
+
+typedef enum {
+    GPS_PROTOCOL_NMEA = 0,
+    GPS_PROTOCOL_UBX,
+} gps_protocol;
+
+// Protocol the receiver is expected to speak after reset
+#ifndef GPS_DEFAULT_PROTOCOL
+#define GPS_DEFAULT_PROTOCOL GPS_PROTOCOL_NMEA
+#endif
+
+// How fixes go out on the bus. CANLIB is canlib's time, latitude, longitude, info and altitude
+// messages. COMPACT packs the same fix into three GPS_MSG_FIX_* frames, see gps_msgs.h. Velocity
+// goes out the same way with either.
+typedef enum {
+    GPS_ENCODING_CANLIB = 0,
+    GPS_ENCODING_COMPACT,
+} gps_encoding;
+
+#ifndef GPS_DEFAULT_ENCODING
+#define GPS_DEFAULT_ENCODING GPS_ENCODING_CANLIB
+#endif
+
+// With the canlib encoding GPS_MSG_CONSTELLATION goes out when the constellation changes, and
+// again this often so that a board that starts listening later hears it
+#ifndef GPS_CONSTELLATION_REPEAT_ms
+#define GPS_CONSTELLATION_REPEAT_ms 5000
+#endif
+
+// GPS time is ahead of UTC by this many seconds, as of 2017. Only used to get GPS time of week
+// from NMEA, which gives UTC.
+#ifndef GPS_UTC_LEAP_SECONDS
+#define GPS_UTC_LEAP_SECONDS 18
+#endif
+
+#define GPS_TOW_UNKNOWN 0xffffffffUL
+#define GPS_MS_PER_WEEK 604800000UL
+
+typedef struct {
+    uint8_t deg;
+    uint8_t min;
+    uint16_t dmin; // 1e-4 minutes
+    char dir; // N/S or E/W
+} gps_coord_t;
+
+// One navigation solution in the units the CAN messages carry, filled by whichever protocol
+// decoder is active
+typedef struct {
+    uint8_t hour;
+    uint8_t min;
+    uint8_t sec;
+    uint8_t csec; // hundredths of a second
+    gps_coord_t lat;
+    gps_coord_t lon;
+    uint16_t alt; // above mean sea level, whole units
+    uint8_t calt; // hundredths of a unit
+    char alt_units;
+    uint8_t numsat;
+    uint8_t quality; // GGA quality indicator
+    gnss_constellation constellation;
+    uint16_t speed; // over ground, cm/s
+    uint16_t course; // over ground relative to true north, 0.01 degrees
+    // For the compact encoding
+    uint32_t tow; // GPS time of week in ms, GPS_TOW_UNKNOWN until NMEA has given the date
+    int32_t lat_e7; // 1e-7 degrees, north positive
+    int32_t lon_e7; // 1e-7 degrees, east positive
+    int32_t alt_dm; // above mean sea level, decimetres
+} gps_fix_t;
+
+// Kinds of message counted in gps_stats_t
+typedef enum {
+    GPS_STATS_GGA = 0,
+    GPS_STATS_RMC,
+    GPS_STATS_NMEA_OTHER, // sentences we don't decode
+    GPS_STATS_UBX_NAV_PVT,
+    GPS_STATS_UBX_OTHER,
+    GPS_STATS_TYPES,
+} gps_stats_type;
+
+// Parser health since boot, across both protocols. Every count wraps around.
+typedef struct {
+    uint16_t seen[GPS_STATS_TYPES]; // whether or not they turn out to be intact
+    uint16_t checksum_errors;
+    uint16_t truncated; // NMEA cut off before its checksum, by a line end or the next '$'
+    uint16_t overlong_fields; // decoded NMEA fields longer than we keep, so some was lost
+    uint16_t framing_errors; // UBX headers giving a length longer than any message we decode
+} gps_stats_t;
+
 void gps_init(void);
 
+// Builds and enqueues the CAN messages for the latest fix committed since it last ran, if any.
+// Called from the main loop.
 void assemble_can_msgs(void);
 
+void gps_set_protocol(gps_protocol protocol);
+
+void gps_set_encoding(gps_encoding encoding);
+
 void gps_handle_byte(uint8_t byte);
 
+// Feeds a chunk of received bytes to the parser, as handed over by uart_rx_peek()
+void gps_handle_bytes(const uint8_t *data, uint16_t length);
+
+// Sentences or messages received with a good checksum, in either protocol. Wraps around.
+uint16_t gps_valid_messages(void);
+
+void gps_get_stats(gps_stats_t *stats);
+
+// Hands a decoded fix's time, position and fix info over to assemble_can_msgs(), replacing any it
+// hasn't got to yet. Safe to call from an interrupt, the fix is copied.
+void gps_commit_position(const gps_fix_t *fix, uint32_t timestamp);
+
+// The same for a fix's velocity
+void gps_commit_velocity(const gps_fix_t *fix, uint32_t timestamp);
+
+// Positions committed with a fix, a quality other than 0. Wraps around.
+uint16_t gps_fixes(void);
+
 #endif /* GPS_H */
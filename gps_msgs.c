@@ -0,0 +1,175 @@
+#include "gps_msgs.h"
+
+// Payload bytes after the timestamp in a debug raw message
+#define GPS_MSG_PAYLOAD_LEN 6
+
+bool build_gps_velocity_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint16_t speed, uint16_t course, can_msg_t *output
+) {
+    uint8_t payload[GPS_MSG_PAYLOAD_LEN] = {0};
+    payload[0] = GPS_MSG_VELOCITY;
+    payload[1] = speed >> 8;
+    payload[2] = speed & 0xff;
+    payload[3] = course >> 8;
+    payload[4] = course & 0xff;
+
+    return build_debug_raw_msg(prio, timestamp, payload, output);
+}
+
+bool build_gps_constellation_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t constellation, can_msg_t *output
+) {
+    uint8_t payload[GPS_MSG_PAYLOAD_LEN] = {0};
+    payload[0] = GPS_MSG_CONSTELLATION;
+    payload[1] = constellation;
+
+    return build_debug_raw_msg(prio, timestamp, payload, output);
+}
+
+bool build_gps_clock_msg(
+    can_msg_prio_t prio, uint16_t timestamp, bool locked, int32_t osc_error, can_msg_t *output
+) {
+    uint8_t payload[GPS_MSG_PAYLOAD_LEN] = {0};
+    payload[0] = GPS_MSG_CLOCK;
+    payload[1] = locked;
+    payload[2] = (uint32_t)osc_error >> 24;
+    payload[3] = ((uint32_t)osc_error >> 16) & 0xff;
+    payload[4] = ((uint32_t)osc_error >> 8) & 0xff;
+    payload[5] = (uint32_t)osc_error & 0xff;
+
+    return build_debug_raw_msg(prio, timestamp, payload, output);
+}
+
+bool build_gps_time_sync_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t seq, uint32_t second_of_day,
+    can_msg_t *output
+) {
+    uint8_t payload[GPS_MSG_PAYLOAD_LEN] = {0};
+    payload[0] = GPS_MSG_TIME_SYNC;
+    payload[1] = seq;
+    payload[2] = (second_of_day >> 16) & 0xff;
+    payload[3] = (second_of_day >> 8) & 0xff;
+    payload[4] = second_of_day & 0xff;
+
+    return build_debug_raw_msg(prio, timestamp, payload, output);
+}
+
+bool build_gps_time_follow_up_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t seq, uint32_t after_edge, can_msg_t *output
+) {
+    uint8_t payload[GPS_MSG_PAYLOAD_LEN] = {0};
+    payload[0] = GPS_MSG_TIME_FOLLOW_UP;
+    payload[1] = seq;
+    payload[2] = after_edge >> 24;
+    payload[3] = (after_edge >> 16) & 0xff;
+    payload[4] = (after_edge >> 8) & 0xff;
+    payload[5] = after_edge & 0xff;
+
+    return build_debug_raw_msg(prio, timestamp, payload, output);
+}
+
+bool build_gps_health_msg(
+    can_msg_prio_t prio, uint16_t timestamp, gps_health_counter counter, uint32_t value,
+    can_msg_t *output
+) {
+    uint8_t payload[GPS_MSG_PAYLOAD_LEN] = {0};
+    payload[0] = GPS_MSG_HEALTH;
+    payload[1] = counter;
+    payload[2] = value >> 24;
+    payload[3] = (value >> 16) & 0xff;
+    payload[4] = (value >> 8) & 0xff;
+    payload[5] = value & 0xff;
+
+    return build_debug_raw_msg(prio, timestamp, payload, output);
+}
+
+bool build_gps_board_telemetry_msg(
+    can_msg_prio_t prio, uint16_t timestamp, gps_telemetry_channel channel, uint16_t value,
+    can_msg_t *output
+) {
+    uint8_t payload[GPS_MSG_PAYLOAD_LEN] = {0};
+    payload[0] = GPS_MSG_BOARD_TELEMETRY;
+    payload[1] = channel;
+    payload[2] = value >> 8;
+    payload[3] = value & 0xff;
+
+    return build_debug_raw_msg(prio, timestamp, payload, output);
+}
+
+bool build_gps_isr_profile_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t branch, uint8_t part, uint32_t value,
+    can_msg_t *output
+) {
+    uint8_t payload[GPS_MSG_PAYLOAD_LEN] = {0};
+    payload[0] = GPS_MSG_ISR_PROFILE;
+    payload[1] = (branch << 4) | (part & 0x0f);
+    payload[2] = value >> 24;
+    payload[3] = (value >> 16) & 0xff;
+    payload[4] = (value >> 8) & 0xff;
+    payload[5] = value & 0xff;
+
+    return build_debug_raw_msg(prio, timestamp, payload, output);
+}
+
+bool build_gps_task_stats_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t task, uint8_t part, uint32_t value,
+    can_msg_t *output
+) {
+    uint8_t payload[GPS_MSG_PAYLOAD_LEN] = {0};
+    payload[0] = GPS_MSG_TASK_STATS;
+    payload[1] = (task << 4) | (part & 0x0f);
+    payload[2] = value >> 24;
+    payload[3] = (value >> 16) & 0xff;
+    payload[4] = (value >> 8) & 0xff;
+    payload[5] = value & 0xff;
+
+    return build_debug_raw_msg(prio, timestamp, payload, output);
+}
+
+bool build_gps_receiver_state_msg(
+    can_msg_prio_t prio, uint16_t timestamp, gps_receiver_state state, uint8_t resets,
+    uint8_t backoff, uint16_t ttff, can_msg_t *output
+) {
+    uint8_t payload[GPS_MSG_PAYLOAD_LEN] = {0};
+    payload[0] = GPS_MSG_RECEIVER_STATE;
+    payload[1] = state;
+    payload[2] = resets;
+    payload[3] = backoff;
+    payload[4] = ttff >> 8;
+    payload[5] = ttff & 0xff;
+
+    return build_debug_raw_msg(prio, timestamp, payload, output);
+}
+
+// One frame of a compact fix, with first and last going into the timestamp's bytes and the last
+// payload byte
+static bool build_fix_frame(
+    can_msg_prio_t prio, gps_msg_id id, uint8_t seq, uint8_t first, uint32_t value, uint8_t last,
+    can_msg_t *output
+) {
+    uint8_t payload[GPS_MSG_PAYLOAD_LEN];
+    payload[0] = id;
+    payload[1] = value >> 24;
+    payload[2] = (value >> 16) & 0xff;
+    payload[3] = (value >> 8) & 0xff;
+    payload[4] = value & 0xff;
+    payload[5] = last;
+
+    return build_debug_raw_msg(prio, ((uint16_t)seq << 8) | first, payload, output);
+}
+
+bool build_gps_fix_msgs(
+    can_msg_prio_t prio, uint8_t seq, uint32_t tow, uint8_t info, uint8_t numsat, int32_t lat,
+    int32_t lon, int32_t alt, can_msg_t *output
+) {
+    uint32_t alt_bits = (uint32_t)alt;
+    return build_fix_frame(prio, GPS_MSG_FIX_TIME, seq, info, tow, numsat, &output[0])
+           && build_fix_frame(
+               prio, GPS_MSG_FIX_LAT, seq, alt_bits >> 24, (uint32_t)lat, (alt_bits >> 16) & 0xff,
+               &output[1]
+           )
+           && build_fix_frame(
+               prio, GPS_MSG_FIX_LON, seq, (alt_bits >> 8) & 0xff, (uint32_t)lon, alt_bits & 0xff,
+               &output[2]
+           );
+}
@@ -0,0 +1,168 @@
+#ifndef GPS_MSGS_H
+#define GPS_MSGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "canlib.h"
+
+// GPS board telemetry that canlib has no message type for. These go out as MSG_DEBUG_RAW frames,
+// the first payload byte says which of these it is and the rest are big endian fields.
+typedef enum {
+    GPS_MSG_VELOCITY = 0x01,
+    GPS_MSG_CLOCK = 0x02,
+    GPS_MSG_TIME_SYNC = 0x03,
+    GPS_MSG_TIME_FOLLOW_UP = 0x04,
+    GPS_MSG_HEALTH = 0x05,
+    GPS_MSG_ISR_PROFILE = 0x06,
+    // To the board whose type and instance ids are in the next two bytes, the byte after them 1
+    // to reset after the dump
+    GPS_MSG_ISR_PROFILE_REQUEST = 0x07,
+    GPS_MSG_FIX_TIME = 0x08,
+    GPS_MSG_FIX_LAT = 0x09,
+    GPS_MSG_FIX_LON = 0x0A,
+    GPS_MSG_BOARD_TELEMETRY = 0x0B,
+    GPS_MSG_TASK_STATS = 0x0C,
+    GPS_MSG_RECEIVER_STATE = 0x0D,
+    GPS_MSG_CONSTELLATION = 0x0E,
+} gps_msg_id;
+
+// The compact encoding sends a fix as three frames that need no canlib timestamp, since the time
+// of week says when the fix is for. Their first two bytes carry data instead, so the id stays in
+// data[2] like the other messages:
+//
+//   FIX_TIME: seq, info, id, time of week ms (4), numsat
+//   FIX_LAT:  seq, alt bits 31-24, id, lat 1e-7 degrees (4), alt bits 23-16
+//   FIX_LON:  seq, alt bits 15-8, id, lon 1e-7 degrees (4), alt bits 7-0
+//
+// seq is the same in all three frames of a fix and counts up by one per fix. info is the GGA
+// quality indicator with the gnss_constellation in the upper nibble. Altitude is in decimetres,
+// everything is signed or unsigned big endian.
+#define GPS_FIX_FRAMES 3
+#define GPS_FIX_INFO_QUALITY_MASK 0x0f
+#define GPS_FIX_INFO_CONSTELLATION_SHIFT 4
+
+// Counters a health message can carry. The seen counts are in gps_stats_type order.
+typedef enum {
+    GPS_HEALTH_UART_BYTES = 0,
+    GPS_HEALTH_UART_DROPPED,
+    GPS_HEALTH_UART_FIFO_OVERRUNS,
+    GPS_HEALTH_UART_FRAME_ERRORS,
+    GPS_HEALTH_SEEN_GGA,
+    GPS_HEALTH_SEEN_RMC,
+    GPS_HEALTH_SEEN_NMEA_OTHER,
+    GPS_HEALTH_SEEN_UBX_NAV_PVT,
+    GPS_HEALTH_SEEN_UBX_OTHER,
+    GPS_HEALTH_CHECKSUM_ERRORS,
+    GPS_HEALTH_TRUNCATED,
+    GPS_HEALTH_OVERLONG_FIELDS,
+    GPS_HEALTH_TX_OVERWRITTEN,
+    GPS_HEALTH_FRAMING_ERRORS,
+    GPS_HEALTH_COUNTERS,
+} gps_health_counter;
+
+// Board measurements, those up to GPS_TELEMETRY_ADC_CHANNELS taken by error_checks.c's ADC
+// sequencer. The 5V current also goes out as canlib's SENSOR_5V_CURR analog message.
+typedef enum {
+    GPS_TELEMETRY_CURRENT = 0, // 5V current, mA
+    GPS_TELEMETRY_TEMPERATURE, // die temperature indicator output in its low range, 0.1 mV
+    GPS_TELEMETRY_VDD, // supply voltage, mV
+    GPS_TELEMETRY_ADC_CHANNELS,
+    // Time the CPU spent idle since the last board status, 0.1%, sent along with it
+    GPS_TELEMETRY_IDLE = GPS_TELEMETRY_ADC_CHANNELS,
+} gps_telemetry_channel;
+
+// How the receiver is doing, as gps_recovery.c sees it. Each is worse than the one after it.
+typedef enum {
+    GPS_RECEIVER_NO_DATA = 0,
+    GPS_RECEIVER_NO_VALID_MESSAGES, // bytes, but no sentence or UBX message with a good checksum
+    GPS_RECEIVER_NO_FIX,
+    GPS_RECEIVER_HEALTHY,
+} gps_receiver_state;
+
+// speed: over ground in cm/s, course: over ground relative to true north in 0.01 degrees
+bool build_gps_velocity_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint16_t speed, uint16_t course, can_msg_t *output
+);
+
+// constellation: a gnss_constellation, for canlib's info message that has no room for it
+bool build_gps_constellation_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t constellation, can_msg_t *output
+);
+
+// locked: the board's clock is disciplined to PPS, osc_error: the measured error of its
+// oscillator in parts per billion
+bool build_gps_clock_msg(
+    can_msg_prio_t prio, uint16_t timestamp, bool locked, int32_t osc_error, can_msg_t *output
+);
+
+// Sent for a PPS edge, with the local millis() of the edge as the timestamp. seq: matches it to
+// its follow up, second_of_day: UTC of the edge in whole seconds since midnight
+bool build_gps_time_sync_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t seq, uint32_t second_of_day,
+    can_msg_t *output
+);
+
+// Sent once the sync with the same seq has gone to the CAN hardware. after_edge: how long after
+// the PPS edge that was, in microseconds
+bool build_gps_time_follow_up_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t seq, uint32_t after_edge, can_msg_t *output
+);
+
+// Parts of one branch's isr_profile_stats_t, each sent as its own message
+typedef enum {
+    GPS_ISR_PROFILE_COUNT = 0,
+    GPS_ISR_PROFILE_MIN_MAX, // min in the upper 16 bits
+    GPS_ISR_PROFILE_BUCKETS, // and on, two buckets per part, the lower numbered one upper
+} gps_isr_profile_part;
+
+// One counter from uart_rx_stats_t, gps_stats_t or can_tx_overwritten(), as it stands since boot
+bool build_gps_health_msg(
+    can_msg_prio_t prio, uint16_t timestamp, gps_health_counter counter, uint32_t value,
+    can_msg_t *output
+);
+
+// One filtered value from the board telemetry table, in the channel's units
+bool build_gps_board_telemetry_msg(
+    can_msg_prio_t prio, uint16_t timestamp, gps_telemetry_channel channel, uint16_t value,
+    can_msg_t *output
+);
+
+// branch: an isr_profile_branch, in the upper nibble of the second byte with part in the lower
+bool build_gps_isr_profile_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t branch, uint8_t part, uint32_t value,
+    can_msg_t *output
+);
+
+// Sent when the receiver's state changes. resets: since power on, saturating. backoff: resets in
+// a row without getting back to healthy. ttff: time to first fix after power on or the last
+// reset in 0.1 s, 0xffff until there has been one.
+bool build_gps_receiver_state_msg(
+    can_msg_prio_t prio, uint16_t timestamp, gps_receiver_state state, uint8_t resets,
+    uint8_t backoff, uint16_t ttff, can_msg_t *output
+);
+
+// Parts of one main loop task's scheduler_stats_t, each sent as its own message
+typedef enum {
+    GPS_TASK_STATS_RUNS = 0,
+    GPS_TASK_STATS_BUSY_US, // wraps around
+    GPS_TASK_STATS_MAX_US,
+    GPS_TASK_STATS_OVERRUNS,
+    GPS_TASK_STATS_PARTS,
+} gps_task_stats_part;
+
+// task: its place in main.c's task table, in the upper nibble of the second byte with part in the
+// lower
+bool build_gps_task_stats_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t task, uint8_t part, uint32_t value,
+    can_msg_t *output
+);
+
+// The three frames of a fix in the compact encoding, output[0] to output[2]. tow: GPS time of
+// week in ms, info: quality and constellation as above.
+bool build_gps_fix_msgs(
+    can_msg_prio_t prio, uint8_t seq, uint32_t tow, uint8_t info, uint8_t numsat, int32_t lat,
+    int32_t lon, int32_t alt, can_msg_t *output
+);
+
+#endif /* GPS_MSGS_H */
@@ -0,0 +1,192 @@
+#include <xc.h>
+
+#include "canlib.h"
+
+#include "can_tx.h"
+#include "gps_config.h"
+#include "gps_module.h"
+#include "gps_msgs.h"
+#include "gps_recovery.h"
+#include "timebase.h"
+#include "uart_rx.h"
+
+#define TTFF_NONE 0xffff
+
+typedef enum {
+    RECOVERY_RUNNING = 0,
+    RECOVERY_PULSE, // ~HWR low
+    RECOVERY_BOOT, // ~HWR released, receiver starting up
+} recovery_phase;
+
+static struct {
+    gps_receiver_state state;
+    recovery_phase phase;
+    uint32_t phase_start;
+    uint32_t recovered_ms; // power on or the end of the last reset
+
+    // Counters as last seen, and when each last moved
+    uint32_t bytes;
+    uint16_t valid;
+    uint16_t fixes;
+    uint32_t last_byte_ms;
+    uint32_t last_valid_ms;
+    uint32_t last_fix_ms;
+
+    uint16_t ttff; // 0.1 s from recovered_ms
+    uint8_t resets;
+    uint8_t backoff;
+} rec;
+
+static void publish_state(void) {
+    can_msg_t msg;
+    build_gps_receiver_state_msg(
+        PRIO_MEDIUM, millis(), rec.state, rec.resets, rec.backoff, rec.ttff, &msg
+    );
+    can_tx_enqueue(&msg);
+}
+
+// Takes the counters as they stand without counting that as the receiver having sent anything
+static void sync_counters(void) {
+    uart_rx_stats_t uart;
+    uart_rx_get_stats(&uart);
+    rec.bytes = uart.bytes;
+    rec.valid = gps_valid_messages();
+    rec.fixes = gps_fixes();
+}
+
+static void start_over(uint32_t now) {
+    sync_counters();
+    rec.recovered_ms = now;
+    rec.ttff = TTFF_NONE;
+}
+
+void gps_recovery_init(void) {
+    uint32_t now = millis();
+    rec.state = GPS_RECEIVER_NO_DATA;
+    rec.phase = RECOVERY_RUNNING;
+    rec.resets = 0;
+    rec.backoff = 0;
+
+    // Nothing seen yet
+    rec.last_byte_ms = now - GPS_RECEIVER_STALE_ms;
+    rec.last_valid_ms = rec.last_byte_ms;
+    rec.last_fix_ms = rec.last_byte_ms;
+    start_over(now);
+}
+
+static void update_counters(uint32_t now) {
+    uart_rx_stats_t uart;
+    uart_rx_get_stats(&uart);
+    if (uart.bytes != rec.bytes) {
+        rec.bytes = uart.bytes;
+        rec.last_byte_ms = now;
+    }
+
+    uint16_t valid = gps_valid_messages();
+    if (valid != rec.valid) {
+        rec.valid = valid;
+        rec.last_valid_ms = now;
+    }
+
+    uint16_t fixes = gps_fixes();
+    if (fixes != rec.fixes) {
+        rec.fixes = fixes;
+        rec.last_fix_ms = now;
+        if (rec.ttff == TTFF_NONE) {
+            uint32_t ttff = (now - rec.recovered_ms) / 100;
+            rec.ttff = ttff < TTFF_NONE ? ttff : TTFF_NONE - 1;
+        }
+    }
+}
+
+static gps_receiver_state current_state(uint32_t now) {
+    if (now - rec.last_byte_ms >= GPS_RECEIVER_STALE_ms) {
+        return GPS_RECEIVER_NO_DATA;
+    }
+    if (now - rec.last_valid_ms >= GPS_RECEIVER_STALE_ms) {
+        return GPS_RECEIVER_NO_VALID_MESSAGES;
+    }
+    if (now - rec.last_fix_ms >= GPS_RECEIVER_STALE_ms) {
+        return GPS_RECEIVER_NO_FIX;
+    }
+    return GPS_RECEIVER_HEALTHY;
+}
+
+// Whether the receiver has gone without what it's missing for long enough to reset it
+static bool reset_due(uint32_t now) {
+    // Without data counts from the last valid message, so that bursts of noise don't restart it
+    uint32_t last = rec.last_valid_ms;
+    uint32_t timeout = GPS_RECOVERY_TIMEOUT_ms;
+    if (rec.state == GPS_RECEIVER_NO_FIX) {
+        last = rec.last_fix_ms;
+        timeout = GPS_RECOVERY_NO_FIX_ms;
+    }
+
+    uint32_t waited = now - last;
+    if (now - rec.recovered_ms < waited) {
+        waited = now - rec.recovered_ms;
+    }
+    return waited >= timeout << rec.backoff;
+}
+
+void gps_recovery_heartbeat(void) {
+    uint32_t now = millis();
+
+    switch (rec.phase) {
+        case RECOVERY_PULSE:
+            if (now - rec.phase_start >= GPS_RESET_PULSE_ms) {
+                LATC2 = 1;
+                rec.phase = RECOVERY_BOOT;
+                rec.phase_start = now;
+            }
+            return;
+
+        case RECOVERY_BOOT:
+            if (now - rec.phase_start >= GPS_RESET_BOOT_ms) {
+                // A hardware reset puts the receiver back to its saved settings
+                gps_config_start();
+                rec.phase = RECOVERY_RUNNING;
+                start_over(now);
+            }
+            return;
+
+        case RECOVERY_RUNNING:
+        default:
+            break;
+    }
+
+    update_counters(now);
+    gps_receiver_state state = current_state(now);
+    if (state != rec.state) {
+        rec.state = state;
+        if (state == GPS_RECEIVER_HEALTHY) {
+            rec.backoff = 0;
+        }
+        publish_state();
+    }
+
+    // Leave the receiver alone while it's being configured
+    gps_config_state config = gps_config_get_state();
+    if (state == GPS_RECEIVER_HEALTHY || (config != GPS_CONFIG_DONE && config != GPS_CONFIG_FAILED)
+        || !reset_due(now)) {
+        return;
+    }
+
+    LATC2 = 0;
+    rec.phase = RECOVERY_PULSE;
+    rec.phase_start = now;
+    if (rec.resets != UINT8_MAX) {
+        rec.resets++;
+    }
+    if (rec.backoff < GPS_RECOVERY_MAX_BACKOFF) {
+        rec.backoff++;
+    }
+
+    can_msg_t board_stat_msg;
+    build_general_board_status_msg(PRIO_LOW, millis(), 0, 1, &board_stat_msg);
+    can_tx_enqueue(&board_stat_msg);
+}
+
+gps_receiver_state gps_recovery_state(void) {
+    return rec.state;
+}
@@ -0,0 +1,31 @@
+#ifndef GPS_RECOVERY_H
+#define GPS_RECOVERY_H
+
+#include "gps_msgs.h"
+
+// Watches what the receiver sends and resets it through ~HWR when it goes silent, sends nothing
+// with a good checksum, or goes a long time without a fix. The reset is paced from the main loop
+// rather than with delays. Each reset in a row that doesn't bring the receiver back to healthy
+// doubles the wait before the next. State changes go out as GPS_MSG_RECEIVER_STATE messages.
+
+// Data, valid messages or a fix older than this no longer count. The receiver sends every second
+// at the least.
+#define GPS_RECEIVER_STALE_ms 2000
+// Time without valid messages, or without a fix, before the first reset
+#define GPS_RECOVERY_TIMEOUT_ms 5000UL
+#define GPS_RECOVERY_NO_FIX_ms 600000UL // a cold start with a poor view of the sky can take minutes
+// The wait doubles with each reset in a row, up to this many times
+#define GPS_RECOVERY_MAX_BACKOFF 4
+// ~HWR is held low this long, then the receiver gets this long to boot before it's configured
+#define GPS_RESET_PULSE_ms 100
+#define GPS_RESET_BOOT_ms 100
+
+// Called after gps_config_start()
+void gps_recovery_init(void);
+
+// Called from the main loop every few milliseconds
+void gps_recovery_heartbeat(void);
+
+gps_receiver_state gps_recovery_state(void);
+
+#endif /* GPS_RECOVERY_H */
@@ -0,0 +1,26 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+uint8_t *bench_load_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *buf = malloc(size > 0 ? size : 1);
+    if (!buf || fread(buf, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "%s: read failed\n", path);
+        exit(EXIT_FAILURE);
+    }
+    fclose(f);
+
+    *len = size;
+    return buf;
+}
@@ -0,0 +1,35 @@
+#ifndef HOST_BENCH_H
+#define HOST_BENCH_H
+
+// Timing helpers shared by the host benchmarks
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+// Free-running cycle counter, or nanoseconds where the CPU has no usable TSC
+static inline uint64_t bench_cycles(void) {
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+static inline double bench_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Reads a whole file into a malloc'd buffer. Exits on failure.
+uint8_t *bench_load_file(const char *path, size_t *len);
+
+#endif /* HOST_BENCH_H */
@@ -0,0 +1,345 @@
+// Checks the nmea_convert kernels against the strtodec() + divide/modulo code they replaced,
+// exhaustively over every valid time, latitude and longitude string, checks nmea_coord_e7()
+// against double precision exhaustively over the fractional digits and on random strings, then
+// compares their cost, and how much of it is left for the end of the sentence.
+//
+// usage: bench_convert
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nmea_convert.h"
+
+#include "bench.h"
+
+// strtodec() as it was in gps_module.c
+static void strtodec(const char *str, size_t len, uint32_t *whole, uint16_t *decimal) {
+    uint16_t decimal_place = 1000;
+
+    *whole = 0;
+    *decimal = 0;
+
+    const char *current = str;
+    while (current < str + len && '0' <= *current && '9' >= *current) {
+        *whole = *whole * 10 + (*current - '0');
+        current++;
+    }
+
+    if (current >= str + len || *current != '.') {
+        return;
+    }
+
+    current++;
+
+    while (decimal_place > 0 && current < str + len && '0' <= *current && '9' >= *current) {
+        *decimal += decimal_place * (*current - '0');
+        decimal_place /= 10;
+        current++;
+    }
+}
+
+// Shift-and-subtract 32-bit unsigned divide, the way the PIC18 runtime library does it. The host
+// has a hardware divider, so this stands in for what each / and % costs on the board.
+static uint32_t __attribute__((noinline)) soft_div(uint32_t n, uint32_t d, uint32_t *rem) {
+    uint32_t q = 0, r = 0;
+    for (int i = 31; i >= 0; i--) {
+        r = (r << 1) | ((n >> i) & 1);
+        if (r >= d) {
+            r -= d;
+            q |= 1u << i;
+        }
+    }
+    *rem = r;
+    return q;
+}
+
+typedef struct {
+    uint8_t a, b, c;
+    uint16_t frac;
+} fields_t;
+
+// The GGA field conversions, old and new. For time a/b/c are hh/mm/ss and frac hundredths of a
+// second; for coordinates a/b are deg/min and frac 1e-4 minutes.
+static fields_t old_time(const char *str, size_t len) {
+    uint32_t utc;
+    uint16_t dsec;
+    strtodec(str, len, &utc, &dsec);
+    return (fields_t){utc / 10000 % 100, utc / 100 % 100, utc % 100, dsec / 100};
+}
+
+static fields_t soft_time(const char *str, size_t len) {
+    uint32_t utc, r;
+    uint16_t dsec;
+    strtodec(str, len, &utc, &dsec);
+    uint8_t hh, mm, ss;
+    soft_div(soft_div(utc, 10000, &r), 100, &r);
+    hh = r;
+    soft_div(soft_div(utc, 100, &r), 100, &r);
+    mm = r;
+    soft_div(utc, 100, &r);
+    ss = r;
+    return (fields_t){hh, mm, ss, soft_div(dsec, 100, &r)};
+}
+
+static fields_t new_time(const char *str, size_t len) {
+    nmea_number_t num;
+    memset(&num, 0, sizeof(num));
+    for (size_t i = 0; i < len; i++) {
+        nmea_number_push(&num, str[i]);
+    }
+    return (fields_t){nmea_number_int(&num, 4, 2), nmea_number_int(&num, 2, 2),
+                      nmea_number_int(&num, 0, 2), nmea_number_frac(&num, 2)};
+}
+
+static fields_t old_coord(const char *str, size_t len) {
+    uint32_t whole;
+    uint16_t dmin;
+    strtodec(str, len, &whole, &dmin);
+    return (fields_t){whole / 100, whole % 100, 0, dmin};
+}
+
+static fields_t soft_coord(const char *str, size_t len) {
+    uint32_t whole, r;
+    uint16_t dmin;
+    strtodec(str, len, &whole, &dmin);
+    uint8_t deg = soft_div(whole, 100, &r);
+    return (fields_t){deg, r, 0, dmin};
+}
+
+static fields_t new_coord(const char *str, size_t len) {
+    nmea_number_t num;
+    memset(&num, 0, sizeof(num));
+    for (size_t i = 0; i < len; i++) {
+        nmea_number_push(&num, str[i]);
+    }
+    return (fields_t){nmea_number_int(&num, 2, 3), nmea_number_int(&num, 0, 2), 0,
+                      nmea_number_frac(&num, 4)};
+}
+
+static fields_t e7_coord(const char *str, size_t len) {
+    nmea_coord_t coord;
+    memset(&coord, 0, sizeof(coord));
+    for (size_t i = 0; i < len; i++) {
+        nmea_coord_push(&coord, str[i]);
+    }
+    uint32_t e7 = nmea_coord_e7(&coord);
+    return (fields_t){e7 >> 24, e7 >> 16, e7 >> 8, e7 & 0xff};
+}
+
+static unsigned long mismatches = 0;
+
+static void check(const char *what, const char *str, size_t len, fields_t a, fields_t b) {
+    if (a.a == b.a && a.b == b.b && a.c == b.c && a.frac == b.frac) {
+        return;
+    }
+    if (mismatches++ < 10) {
+        fprintf(stderr, "%s mismatch on \"%.*s\": %u %u %u %u != %u %u %u %u\n", what, (int)len,
+                str, a.a, a.b, a.c, a.frac, b.a, b.b, b.c, b.frac);
+    }
+}
+
+static unsigned long check_times(void) {
+    char str[16];
+    unsigned long count = 0;
+    for (int t = 0; t < 24 * 3600; t++) {
+        for (int cs = 0; cs < 100; cs++) {
+            int len = sprintf(str, "%02d%02d%02d.%02d", t / 3600, t / 60 % 60, t % 60, cs);
+            check("time", str, len, old_time(str, len), new_time(str, len));
+            count++;
+        }
+    }
+    return count;
+}
+
+static unsigned long check_coords(int max_deg, int deg_width) {
+    char str[16];
+    unsigned long count = 0;
+    for (int deg = 0; deg <= max_deg; deg++) {
+        for (int min = 0; min < 60; min++) {
+            for (int frac = 0; frac < 10000; frac++) {
+                int len = sprintf(str, "%0*d%02d.%04d", deg_width, deg, min, frac);
+                check("coord", str, len, old_coord(str, len), new_coord(str, len));
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+// One coordinate string in 1e-7 degrees against the exact value of its first NMEA_COORD_DIGITS
+// fractional digits, which it must be within half a unit of
+static void check_e7(int deg, int deg_width, int min, const char *frac) {
+    char str[32];
+    int len = sprintf(str, "%0*d%02d%s%s", deg_width, deg, min, *frac ? "." : "", frac);
+
+    double minutes = min;
+    double scale = 0.1;
+    for (int i = 0; frac[i] && i < NMEA_COORD_DIGITS; i++, scale /= 10) {
+        minutes += (frac[i] - '0') * scale;
+    }
+    double expected = (deg + minutes / 60) * 1e7;
+
+    nmea_coord_t coord;
+    memset(&coord, 0, sizeof(coord));
+    for (int i = 0; i < len; i++) {
+        nmea_coord_push(&coord, str[i]);
+    }
+    uint32_t e7 = nmea_coord_e7(&coord);
+    if (fabs(e7 - expected) > 0.5 + 1e-6 && mismatches++ < 10) {
+        fprintf(stderr, "e7 mismatch on \"%s\": %u, expected %.3f\n", str, e7, expected);
+    }
+}
+
+// Every fraction of up to 7 digits, at the ends of the range
+static unsigned long check_e7_fractions(void) {
+    static const int ends[][3] = {{0, 2, 0}, {89, 2, 59}, {0, 3, 0}, {179, 3, 59}};
+    char frac[20];
+    unsigned long count = 0;
+    for (size_t e = 0; e < sizeof(ends) / sizeof(ends[0]); e++) {
+        for (int digits = 0; digits <= 7; digits++) {
+            long end = 1;
+            for (int i = 0; i < digits; i++) {
+                end *= 10;
+            }
+            for (long f = 0; f < end; f++) {
+                if (digits) {
+                    sprintf(frac, "%0*ld", digits, f);
+                } else {
+                    frac[0] = 0;
+                }
+                check_e7(ends[e][0], ends[e][1], ends[e][2], frac);
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+// Random coordinates, with up to 9 fractional digits to check the ones past 7 are ignored
+static unsigned long check_e7_random(unsigned long samples) {
+    char frac[10];
+    for (unsigned long n = 0; n < samples; n++) {
+        int digits = rand() % 10;
+        for (int i = 0; i < digits; i++) {
+            frac[i] = '0' + rand() % 10;
+        }
+        frac[digits] = 0;
+        if (rand() % 2) {
+            check_e7(rand() % 91, 2, rand() % 60, frac);
+        } else {
+            check_e7(rand() % 181, 3, rand() % 60, frac);
+        }
+    }
+    return samples;
+}
+
+#define TIMING_SAMPLES 4096
+#define TIMING_PASSES 200
+
+static void print_cost(const char *name, uint64_t cycles) {
+#ifdef BENCH_HAVE_TSC
+    printf("  %-10s %6.1f cycles/field\n", name, (double)cycles / TIMING_SAMPLES / TIMING_PASSES);
+#else
+    printf("  %-10s %6.1f ns/field\n", name, (double)cycles / TIMING_SAMPLES / TIMING_PASSES);
+#endif
+}
+
+static void time_kernel(
+    const char *name, fields_t (*convert)(const char *, size_t), char (*strs)[16], size_t *lens
+) {
+    volatile uint16_t sink = 0;
+    uint64_t start = bench_cycles();
+    for (int pass = 0; pass < TIMING_PASSES; pass++) {
+        for (int i = 0; i < TIMING_SAMPLES; i++) {
+            fields_t f = convert(strs[i], lens[i]);
+            sink += f.a + f.b + f.c + f.frac;
+        }
+    }
+    print_cost(name, bench_cycles() - start);
+}
+
+// Fields already decoded, for what's left to do once the sentence has ended
+static nmea_number_t time_nums[TIMING_SAMPLES], coord_nums[TIMING_SAMPLES];
+static nmea_coord_t e7_coords[TIMING_SAMPLES];
+
+static uint32_t split_time(int i) {
+    const nmea_number_t *num = &time_nums[i];
+    return nmea_number_int(num, 4, 2) + nmea_number_int(num, 2, 2) + nmea_number_int(num, 0, 2)
+           + nmea_number_frac(num, 2);
+}
+
+static uint32_t split_coord(int i) {
+    const nmea_number_t *num = &coord_nums[i];
+    return nmea_number_int(num, 2, 3) + nmea_number_int(num, 0, 2) + nmea_number_frac(num, 4);
+}
+
+static uint32_t split_e7(int i) {
+    return nmea_coord_e7(&e7_coords[i]);
+}
+
+static void time_split(const char *name, uint32_t (*split)(int)) {
+    volatile uint32_t sink = 0;
+    uint64_t start = bench_cycles();
+    for (int pass = 0; pass < TIMING_PASSES; pass++) {
+        for (int i = 0; i < TIMING_SAMPLES; i++) {
+            sink += split(i);
+        }
+    }
+    print_cost(name, bench_cycles() - start);
+}
+
+int main(void) {
+    unsigned long count = check_times();
+    count += check_coords(90, 2);
+    count += check_coords(180, 3);
+    srand(1);
+    count += check_e7_fractions();
+    count += check_e7_random(10000000);
+    printf("checked %lu strings, %lu mismatches\n", count, mismatches);
+
+    static char time_strs[TIMING_SAMPLES][16], coord_strs[TIMING_SAMPLES][16];
+    static char e7_strs[TIMING_SAMPLES][16];
+    static size_t time_lens[TIMING_SAMPLES], coord_lens[TIMING_SAMPLES], e7_lens[TIMING_SAMPLES];
+    for (int i = 0; i < TIMING_SAMPLES; i++) {
+        int t = rand() % (24 * 3600);
+        time_lens[i] = sprintf(time_strs[i], "%02d%02d%02d.%02d", t / 3600, t / 60 % 60, t % 60,
+                               rand() % 100);
+        coord_lens[i] = sprintf(coord_strs[i], "%03d%02d.%04d", rand() % 181, rand() % 60,
+                                rand() % 10000);
+        e7_lens[i] = sprintf(e7_strs[i], "%03d%02d.%07d", rand() % 181, rand() % 60,
+                             rand() % 10000000);
+    }
+
+    // "soft" is the old code with each divide done in software as on the PIC18
+    printf("host cost per field (decode + split):\n");
+    time_kernel("old time", old_time, time_strs, time_lens);
+    time_kernel("soft time", soft_time, time_strs, time_lens);
+    time_kernel("new time", new_time, time_strs, time_lens);
+    time_kernel("old coord", old_coord, coord_strs, coord_lens);
+    time_kernel("soft coord", soft_coord, coord_strs, coord_lens);
+    time_kernel("new coord", new_coord, coord_strs, coord_lens);
+    time_kernel("e7 coord", e7_coord, e7_strs, e7_lens);
+
+    memset(time_nums, 0, sizeof(time_nums));
+    memset(coord_nums, 0, sizeof(coord_nums));
+    memset(e7_coords, 0, sizeof(e7_coords));
+    for (int i = 0; i < TIMING_SAMPLES; i++) {
+        for (size_t j = 0; j < time_lens[i]; j++) {
+            nmea_number_push(&time_nums[i], time_strs[i][j]);
+        }
+        for (size_t j = 0; j < coord_lens[i]; j++) {
+            nmea_number_push(&coord_nums[i], coord_strs[i][j]);
+        }
+        for (size_t j = 0; j < e7_lens[i]; j++) {
+            nmea_coord_push(&e7_coords[i], e7_strs[i][j]);
+        }
+    }
+    printf("of which left for the end of the sentence:\n");
+    time_split("new time", split_time);
+    time_split("new coord", split_coord);
+    time_split("e7 coord", split_e7);
+
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,200 @@
+// Replays recorded receiver logs back to back at the configured line rate, with the timebase and
+// PPS running, and reports what isr_profile.c measured of each interrupt handler branch. The
+// cycle counts come from host_isr.c's cost model rather than the board, so what this checks is
+// how often each branch runs, the load that makes, and that the CAN dump carries the stats
+// unchanged. Logs ending in .ubx are replayed as UBX binary, anything else as NMEA.
+//
+// usage: bench_isr log...
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "canlib.h"
+
+#include "gps_config.h"
+#include "gps_general.h"
+#include "gps_module.h"
+#include "gps_msgs.h"
+#include "isr_profile.h"
+#include "pps.h"
+#include "timebase.h"
+#include "uart_rx.h"
+
+#include "bench.h"
+#include "host_isr.h"
+#include "host_timer.h"
+#include "host_uart.h"
+
+#if !ISR_PROFILE
+#error "bench_isr needs ISR_PROFILE=1"
+#endif
+
+#if UART_RX_DMA
+#define RX_NAME "dma"
+#else
+#define RX_NAME "ring"
+#endif
+
+// Fosc/4
+#define CYCLES_PER_s 12e6
+// Start bit, 8 data bits and a stop bit
+#define BITS_PER_BYTE 10
+
+static const char *const branch_names[ISR_PROFILE_BRANCHES] = {
+    "can", "uart error", "uart rx", "timebase", "pps", "can tx", "adc", "total",
+};
+
+static void poll_uart(void) {
+    const uint8_t *data;
+    uint16_t length;
+    while ((length = uart_rx_peek(&data)) != 0) {
+        gps_handle_bytes(data, length);
+        uart_rx_consume(length);
+    }
+    assemble_can_msgs();
+}
+
+// Sends a dump the way a request over CAN would, and checks it against the stats it came from
+static bool check_dump(const isr_profile_stats_t *stats) {
+    host_can_reset();
+    isr_profile_request_dump(false);
+    for (int i = 0; i < ISR_PROFILE_BRANCHES; i++) {
+        isr_profile_heartbeat();
+    }
+
+    isr_profile_stats_t decoded[ISR_PROFILE_BRANCHES];
+    memset(decoded, 0, sizeof(decoded));
+    size_t parts = 0;
+    for (size_t i = 0; i < host_can_log_len; i++) {
+        const uint8_t *payload = host_can_log[i].data + 2;
+        if (get_message_type(&host_can_log[i]) != MSG_DEBUG_RAW
+            || payload[0] != GPS_MSG_ISR_PROFILE) {
+            continue;
+        }
+        uint8_t branch = payload[1] >> 4;
+        uint8_t part = payload[1] & 0x0f;
+        uint32_t value = ((uint32_t)payload[2] << 24) | ((uint32_t)payload[3] << 16)
+                         | ((uint32_t)payload[4] << 8) | payload[5];
+        if (branch >= ISR_PROFILE_BRANCHES) {
+            return false;
+        }
+
+        isr_profile_stats_t *s = &decoded[branch];
+        if (part == GPS_ISR_PROFILE_COUNT) {
+            s->count = value;
+        } else if (part == GPS_ISR_PROFILE_MIN_MAX) {
+            s->min = value >> 16;
+            s->max = value & 0xffff;
+        } else {
+            uint8_t bucket = (part - GPS_ISR_PROFILE_BUCKETS) * 2;
+            s->buckets[bucket] = value >> 16;
+            s->buckets[bucket + 1] = value & 0xffff;
+        }
+        parts++;
+    }
+
+    if (parts != ISR_PROFILE_BRANCHES * (GPS_ISR_PROFILE_BUCKETS + ISR_PROFILE_BUCKETS / 2)) {
+        return false;
+    }
+    for (int b = 0; b < ISR_PROFILE_BRANCHES; b++) {
+        isr_profile_stats_t expected = stats[b];
+        if (expected.count == 0) {
+            expected.min = 0; // sent as 0 rather than UINT16_MAX
+        }
+        if (memcmp(&expected, &decoded[b], sizeof(expected)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool replay(const char *path) {
+    size_t len;
+    uint8_t *log = bench_load_file(path, &len);
+    size_t name_len = strlen(path);
+    bool ubx = name_len > 4 && strcmp(path + name_len - 4, ".ubx") == 0;
+
+    host_osc_error_ppm = 0;
+    host_pps_enabled = true;
+    host_pps_offset_ns = 0.5e9;
+    host_pps_jitter_ns = 0;
+    host_clock_reset();
+    host_can_reset();
+    timebase_init();
+    pps_init();
+    uart_init();
+    gps_init();
+    gps_set_protocol(ubx ? GPS_PROTOCOL_UBX : GPS_PROTOCOL_NMEA);
+    host_uart_baud = GPS_CONFIG_BAUD;
+    host_isr_cycles = 0;
+    isr_profile_init();
+
+    double byte_ns = BITS_PER_BYTE * 1e9 / host_uart_baud;
+    double t = 0;
+    uint32_t last_ms = millis();
+    for (size_t i = 0; i < len; i++) {
+        t += byte_ns;
+        host_clock_run(t);
+        host_uart_receive(log[i]);
+        // The main loop gets round about once a millisecond
+        if (millis() != last_ms) {
+            last_ms = millis();
+            poll_uart();
+        }
+    }
+#if UART_RX_DMA
+    // Let the line go idle so the last partial half is handed over
+    t += (UART_RX_IDLE_ms + 1) * 1e6;
+    host_clock_run(t);
+    poll_uart();
+#endif
+    free(log);
+
+    double seconds = t / 1e9;
+    printf("%s: %s, %zu bytes at %u baud, %.2f s\n", RX_NAME, path, len, host_uart_baud, seconds);
+    printf("  %-10s %8s %9s %6s %6s  cycles: <%u, then doubling\n", "branch", "runs", "per s",
+           "min", "max", ISR_PROFILE_BUCKET_0_CYCLES);
+
+    isr_profile_stats_t stats[ISR_PROFILE_BRANCHES];
+    for (int b = 0; b < ISR_PROFILE_BRANCHES; b++) {
+        isr_profile_get(b, &stats[b]);
+        const isr_profile_stats_t *s = &stats[b];
+        if (s->count == 0) {
+            continue;
+        }
+        printf("  %-10s %8u %9.0f %6u %6u ", branch_names[b], s->count, s->count / seconds,
+               s->min, s->max);
+        for (int k = 0; k < ISR_PROFILE_BUCKETS; k++) {
+            printf(" %6u", s->buckets[k]);
+        }
+        printf("\n");
+    }
+
+    double char_cycles = byte_ns * 1e-9 * CYCLES_PER_s;
+    uint16_t longest = stats[ISR_PROFILE_TOTAL].max;
+    printf("  interrupt load %.2f%%, longest handler %u cycles, %.0f%% of a character time\n",
+           100 * host_isr_cycles / (seconds * CYCLES_PER_s), longest, 100 * longest / char_cycles);
+
+    bool ok = uart_rx_dropped() == 0 && stats[ISR_PROFILE_PPS].count > 0
+              && stats[ISR_PROFILE_UART_RX].count > 0 && check_dump(stats);
+    if (!ok) {
+        fprintf(stderr, "  bytes dropped, a branch never ran, or the dump didn't match\n");
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s log...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        ok &= replay(argv[i]);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,222 @@
+// Replays recorded receiver logs through gps_handle_byte(), and through the UART receive buffer
+// the way the firmware does, and reports parser throughput. Logs ending in .ubx are replayed as
+// UBX binary, anything else as NMEA.
+//
+// usage: bench_replay [-n repeats] log...
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "canlib.h"
+
+#include "gps_general.h"
+#include "gps_module.h"
+#include "timebase.h"
+#include "uart_rx.h"
+
+#include "bench.h"
+#include "host_timer.h"
+#include "host_uart.h"
+
+// Bytes that arrive between main loop polls in the buffered replay
+#define RX_BURST 32
+
+#if UART_RX_DMA
+#define BUFFERED_NAME "dma"
+#else
+#define BUFFERED_NAME "ring"
+#endif
+
+#ifdef BENCH_NMEA_ONLY
+// The reference parser predates chunked parsing
+void gps_handle_bytes(const uint8_t *data, uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        gps_handle_byte(data[i]);
+    }
+}
+
+// and builds its messages as each sentence completes
+void assemble_can_msgs(void) {
+}
+#endif
+
+static uint32_t now_ms = 0;
+
+#ifndef BENCH_NMEA_ONLY
+// What the parser made of one pass, as the health counters report it
+static void print_stats(const gps_stats_t *before, const gps_stats_t *after) {
+    static const char *const names[GPS_STATS_TYPES] = {
+        "GGA", "RMC", "other NMEA", "NAV-PVT", "other UBX",
+    };
+    printf("  seen:");
+    for (int t = 0; t < GPS_STATS_TYPES; t++) {
+        uint16_t seen = after->seen[t] - before->seen[t];
+        if (seen) {
+            printf(" %u %s", seen, names[t]);
+        }
+    }
+    printf(", %u checksum errors, %u truncated, %u overlong fields, %u framing errors\n",
+           (uint16_t)(after->checksum_errors - before->checksum_errors),
+           (uint16_t)(after->truncated - before->truncated),
+           (uint16_t)(after->overlong_fields - before->overlong_fields),
+           (uint16_t)(after->framing_errors - before->framing_errors));
+}
+#endif
+
+static void replay_direct(const uint8_t *log, size_t len) {
+    for (size_t j = 0; j < len; j++) {
+        gps_handle_byte(log[j]);
+        assemble_can_msgs();
+    }
+}
+
+static void poll_uart(void) {
+    const uint8_t *data;
+    uint16_t length;
+    while ((length = uart_rx_peek(&data)) != 0) {
+        gps_handle_bytes(data, length);
+        uart_rx_consume(length);
+    }
+    assemble_can_msgs();
+}
+
+// Same path as the firmware: bytes go into the receive buffer through DMA1 or the UART ISR, and
+// the main loop hands them to the parser in chunks
+static void replay_buffered(const uint8_t *log, size_t len) {
+    for (size_t j = 0; j < len; j += RX_BURST) {
+        size_t end = j + RX_BURST < len ? j + RX_BURST : len;
+        for (size_t k = j; k < end; k++) {
+            host_uart_receive(log[k]);
+        }
+        host_set_millis(++now_ms);
+        poll_uart();
+    }
+
+#if UART_RX_DMA
+    // Let the line go idle so the last partial half is handed over
+    now_ms += UART_RX_IDLE_ms;
+    host_set_millis(now_ms);
+    poll_uart();
+#endif
+}
+
+// Each checked pass starts from a newly configured receiver, so makes the same frames
+static void start_pass(bool ubx) {
+#ifndef BENCH_NMEA_ONLY
+    gps_set_protocol(ubx ? GPS_PROTOCOL_UBX : GPS_PROTOCOL_NMEA);
+#else
+    (void)ubx;
+#endif
+    host_can_reset();
+}
+
+static void run(
+    const char *name, void (*replay)(const uint8_t *, size_t), const uint8_t *log, size_t len,
+    size_t sentences, uint32_t fixes, unsigned repeats
+) {
+    double start_s = bench_seconds();
+    uint64_t start_cyc = bench_cycles();
+    for (unsigned r = 0; r < repeats; r++) {
+        replay(log, len);
+    }
+    uint64_t cycles = bench_cycles() - start_cyc;
+    double elapsed = bench_seconds() - start_s;
+
+    double total_bytes = (double)len * repeats;
+    double total_fixes = (double)fixes * repeats;
+    printf("  %-8s %8.2f MB/s %10.0f messages/s", name, total_bytes / elapsed / 1e6,
+           sentences * (double)repeats / elapsed);
+#ifdef BENCH_HAVE_TSC
+    printf(" %6.1f cycles/byte %8.0f cycles/fix\n", cycles / total_bytes, cycles / total_fixes);
+#else
+    printf(" %6.1f ns/byte %8.0f ns/fix\n", cycles / total_bytes, cycles / total_fixes);
+#endif
+}
+
+int main(int argc, char **argv) {
+    unsigned repeats = 200;
+
+    host_clock_reset();
+    timebase_init();
+    uart_init();
+    // Have DMA1 run a few bytes ahead of its interrupt, as it can behind a higher priority ISR
+    host_uart_irq_latency = 4;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                repeats = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n repeats] log.nmea...\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc || repeats == 0) {
+        fprintf(stderr, "usage: %s [-n repeats] log.nmea...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        size_t len;
+        uint8_t *log = bench_load_file(argv[i], &len);
+
+        size_t name_len = strlen(argv[i]);
+        bool ubx = name_len > 4 && strcmp(argv[i] + name_len - 4, ".ubx") == 0;
+#ifdef BENCH_NMEA_ONLY
+        if (ubx) {
+            continue;
+        }
+#endif
+
+        // NMEA sentences or UBX messages
+        size_t sentences = 0;
+        for (size_t j = 0; j < len; j++) {
+            if (ubx ? (log[j] == 0xb5 && j + 1 < len && log[j + 1] == 0x62) : log[j] == '$') {
+                sentences++;
+            }
+        }
+
+        // One untimed pass to warm the caches and count the frames and fixes a replay produces
+#ifndef BENCH_NMEA_ONLY
+        gps_stats_t stats_before;
+        gps_get_stats(&stats_before);
+#endif
+        start_pass(ubx);
+        replay_direct(log, len);
+        uint32_t frames = host_can_enqueued;
+        uint32_t fixes = host_can_count(MSG_GPS_TIMESTAMP);
+#ifndef BENCH_NMEA_ONLY
+        gps_stats_t stats_after;
+        gps_get_stats(&stats_after);
+#endif
+
+        // The buffered path must hand the parser exactly the same bytes
+        start_pass(ubx);
+        replay_buffered(log, len);
+        if (host_can_enqueued != frames || host_can_count(MSG_GPS_TIMESTAMP) != fixes
+            || uart_rx_dropped() != 0) {
+            fprintf(stderr, "%s: %s: %s replay gave %u frames and %u fixes, expected %u and %u\n",
+                    argv[0], argv[i], BUFFERED_NAME, host_can_enqueued,
+                    host_can_count(MSG_GPS_TIMESTAMP), frames, fixes);
+            return EXIT_FAILURE;
+        }
+
+        printf("%s: %s\n", argv[0], argv[i]);
+        printf("  %zu bytes, %zu messages, %u fixes, %u CAN frames per pass, %u passes\n", len,
+               sentences, fixes, frames, repeats);
+#ifndef BENCH_NMEA_ONLY
+        print_stats(&stats_before, &stats_after);
+#endif
+        run("direct", replay_direct, log, len, sentences, fixes, repeats);
+        run(BUFFERED_NAME, replay_buffered, log, len, sentences, fixes, repeats);
+
+        free(log);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <xc.h>
+
+#include "canlib.h"
+
+#include "can_tx.h"
+
+#include "host_isr.h"
+
+can_msg_t host_can_log[HOST_CAN_LOG_SIZE];
+size_t host_can_log_len = 0;
+uint32_t host_can_enqueued = 0;
+
+#define HOST_CAN_TYPES 64
+static uint32_t type_counts[HOST_CAN_TYPES];
+
+can_msg_t host_can_txb;
+bool host_can_txb_full = false;
+
+// Transmit queue, in place of canlib's pool
+#define TXB_QUEUE_SIZE 64
+static struct {
+    void (*send)(const can_msg_t *);
+    bool (*send_rdy)(void);
+    can_msg_t frames[TXB_QUEUE_SIZE];
+    size_t head;
+    size_t len;
+} txb;
+
+// The SID only carries the message type and priority; board IDs do not matter
+// on the host.
+static void write_header(
+    can_msg_t *output, can_msg_prio_t prio, can_msg_type_t type, uint16_t timestamp,
+    uint8_t data_len
+) {
+    memset(output, 0, sizeof(*output));
+    output->sid = ((uint32_t)prio << 16) | type;
+    output->data[0] = timestamp >> 8;
+    output->data[1] = timestamp & 0xff;
+    output->data_len = data_len;
+}
+
+bool build_general_board_status_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint32_t general_error_bitfield,
+    uint16_t board_specific_error_bitfield, can_msg_t *output
+) {
+    write_header(output, prio, MSG_GENERAL_BOARD_STATUS, timestamp, 8);
+    output->data[2] = general_error_bitfield >> 24;
+    output->data[3] = general_error_bitfield >> 16;
+    output->data[4] = general_error_bitfield >> 8;
+    output->data[5] = general_error_bitfield;
+    output->data[6] = board_specific_error_bitfield >> 8;
+    output->data[7] = board_specific_error_bitfield;
+    return true;
+}
+
+bool build_debug_raw_msg(
+    can_msg_prio_t prio, uint16_t timestamp, const uint8_t *payload, can_msg_t *output
+) {
+    write_header(output, prio, MSG_DEBUG_RAW, timestamp, 8);
+    memcpy(output->data + 2, payload, 6);
+    return true;
+}
+
+bool build_analog_data_msg(
+    can_msg_prio_t prio, uint16_t timestamp, can_analog_sensor_id_t sensor_id, uint16_t sensor_data,
+    can_msg_t *output
+) {
+    write_header(output, prio, MSG_SENSOR_ANALOG, timestamp, 5);
+    output->data[2] = sensor_id;
+    output->data[3] = sensor_data >> 8;
+    output->data[4] = sensor_data;
+    return true;
+}
+
+bool build_gps_time_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t hrs, uint8_t mins, uint8_t secs, uint8_t dsecs,
+    can_msg_t *output
+) {
+    write_header(output, prio, MSG_GPS_TIMESTAMP, timestamp, 6);
+    output->data[2] = hrs;
+    output->data[3] = mins;
+    output->data[4] = secs;
+    output->data[5] = dsecs;
+    return true;
+}
+
+bool build_gps_lat_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t degrees, uint8_t minutes, uint16_t dminutes,
+    uint8_t direction, can_msg_t *output
+) {
+    write_header(output, prio, MSG_GPS_LATITUDE, timestamp, 7);
+    output->data[2] = degrees;
+    output->data[3] = minutes;
+    output->data[4] = dminutes >> 8;
+    output->data[5] = dminutes;
+    output->data[6] = direction;
+    return true;
+}
+
+bool build_gps_lon_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t degrees, uint8_t minutes, uint16_t dminutes,
+    uint8_t direction, can_msg_t *output
+) {
+    write_header(output, prio, MSG_GPS_LONGITUDE, timestamp, 7);
+    output->data[2] = degrees;
+    output->data[3] = minutes;
+    output->data[4] = dminutes >> 8;
+    output->data[5] = dminutes;
+    output->data[6] = direction;
+    return true;
+}
+
+bool build_gps_alt_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint16_t altitude, uint8_t daltitude, uint8_t units,
+    can_msg_t *output
+) {
+    write_header(output, prio, MSG_GPS_ALTITUDE, timestamp, 6);
+    output->data[2] = altitude >> 8;
+    output->data[3] = altitude;
+    output->data[4] = daltitude;
+    output->data[5] = units;
+    return true;
+}
+
+bool build_gps_info_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t num_sat, uint8_t quality, can_msg_t *output
+) {
+    write_header(output, prio, MSG_GPS_INFO, timestamp, 4);
+    output->data[2] = num_sat;
+    output->data[3] = quality;
+    return true;
+}
+
+uint16_t get_message_type(const can_msg_t *msg) {
+    return msg->sid & 0xffff;
+}
+
+bool check_board_need_reset(const can_msg_t *msg) {
+    (void)msg;
+    return false;
+}
+
+void txb_init(
+    void *pool, size_t pool_size, void (*can_send)(const can_msg_t *), bool (*can_send_rdy)(void)
+) {
+    (void)pool;
+    (void)pool_size;
+    txb.send = can_send;
+    txb.send_rdy = can_send_rdy;
+    txb.head = 0;
+    txb.len = 0;
+}
+
+// The TXB0 and CCP3 interrupts take frames off the queue, so on the board it's only safe to touch
+// with them off. Nothing here can interrupt anything, so check that instead.
+static void check_interrupts_off(void) {
+    if (INTCON0bits.GIE) {
+        abort();
+    }
+}
+
+bool txb_enqueue(const can_msg_t *msg) {
+    check_interrupts_off();
+    if (host_can_log_len < HOST_CAN_LOG_SIZE) {
+        host_can_log[host_can_log_len++] = *msg;
+    }
+    host_can_enqueued++;
+    if (get_message_type(msg) < HOST_CAN_TYPES) {
+        type_counts[get_message_type(msg)]++;
+    }
+
+    if (txb.send) {
+        if (txb.len == TXB_QUEUE_SIZE) {
+            return false;
+        }
+        txb.frames[(txb.head + txb.len++) % TXB_QUEUE_SIZE] = *msg;
+    }
+    return true;
+}
+
+void txb_heartbeat(void) {
+    check_interrupts_off();
+    if (txb.send && txb.len > 0 && txb.send_rdy()) {
+        txb.send(&txb.frames[txb.head]);
+        txb.head = (txb.head + 1) % TXB_QUEUE_SIZE;
+        txb.len--;
+    }
+}
+
+void can_send(const can_msg_t *msg) {
+    host_can_txb = *msg;
+    host_can_txb_full = true;
+}
+
+bool can_send_rdy(void) {
+    return !host_can_txb_full;
+}
+
+void host_can_tx_complete(void) {
+    host_can_txb_full = false;
+    PIR5bits.TXB0IF = 1;
+    if (PIE5bits.TXB0IE) {
+        host_isr_run(ISR_PROFILE_CAN_TX, can_tx_handle_tx_interrupt);
+        PIR5bits.TXB0IF = 0;
+    }
+}
+
+void host_can_reset(void) {
+    host_can_log_len = 0;
+    host_can_enqueued = 0;
+    memset(type_counts, 0, sizeof(type_counts));
+    txb.head = 0;
+    txb.len = 0;
+    host_can_txb_full = false;
+    PIR5bits.TXB0IF = 0;
+}
+
+size_t host_can_queued(void) {
+    return txb.len;
+}
+
+uint32_t host_can_count(can_msg_type_t type) {
+    return type < HOST_CAN_TYPES ? type_counts[type] : 0;
+}
@@ -0,0 +1,40 @@
+#include <xc.h>
+
+#include "host_dma.h"
+
+void host_dma_load(void) {
+    DMA1SCNT = DMA1SSZ;
+    DMA1DCNT = DMA1DSZ;
+}
+
+void host_dma_trigger(uint8_t irq) {
+    // Nothing moves until the arbiter priorities are locked
+    if (!DMA1CON0bits.EN || !DMA1CON0bits.SIRQEN || DMA1SIRQ != irq || !PRLOCKbits.PRLOCKED) {
+        return;
+    }
+
+    volatile uint8_t *source = (volatile uint8_t *)DMA1SSA;
+    uint8_t *dest = (uint8_t *)DMA1DSA;
+    if (DMA1CON1bits.SMODE == 0b01) {
+        source += DMA1SSZ - DMA1SCNT;
+    }
+    if (DMA1CON1bits.DMODE == 0b01) {
+        dest += DMA1DSZ - DMA1DCNT;
+    }
+    *dest = *source;
+
+    if (--DMA1SCNT == 0) {
+        DMA1SCNT = DMA1SSZ;
+        PIR2bits.DMA1SCNTIF = 1;
+        if (DMA1CON1bits.SSTP) {
+            DMA1CON0bits.SIRQEN = 0;
+        }
+    }
+    if (--DMA1DCNT == 0) {
+        DMA1DCNT = DMA1DSZ;
+        PIR2bits.DMA1DCNTIF = 1;
+        if (DMA1CON1bits.DSTP) {
+            DMA1CON0bits.SIRQEN = 0;
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef HOST_DMA_H
+#define HOST_DMA_H
+
+// Host model of DMA1 as uart_rx.c uses it: one byte per trigger from a fixed source to an
+// incrementing destination, with the counters reloading and raising their interrupt flags.
+
+#include <stdint.h>
+
+// U1RX interrupt vector number
+#define HOST_IRQ_U1RX 0x1B
+
+// Loads the counters from the size registers, as setting DMA1CON0bits.EN does on the chip
+void host_dma_load(void);
+
+// The interrupt source irq has fired. Moves one byte if DMA1 is enabled and triggered by it.
+void host_dma_trigger(uint8_t irq);
+
+#endif /* HOST_DMA_H */
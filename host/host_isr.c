@@ -0,0 +1,61 @@
+#include <xc.h>
+
+#include "uart_rx.h"
+
+#include "host_isr.h"
+
+// Hardware context save on entry and restore on return, which the profiler can't see
+#define CONTEXT_CYCLES 12
+// Flag tests for the branches that didn't run
+#define DISPATCH_CYCLES 20
+
+// Rough estimates, instruction cycles. Replace them with figures from a board's dump.
+static const struct {
+    uint16_t base;
+    uint16_t spread; // up to this many more, depending on what the handler finds
+} costs[ISR_PROFILE_BRANCHES] = {
+    [ISR_PROFILE_CAN] = {150, 100},
+    [ISR_PROFILE_UART_ERROR] = {20, 10},
+#if UART_RX_DMA
+    [ISR_PROFILE_UART_RX] = {15, 10},
+#else
+    [ISR_PROFILE_UART_RX] = {40, 10},
+#endif
+    [ISR_PROFILE_TIMEBASE] = {60, 30},
+    [ISR_PROFILE_PPS] = {300, 60},
+    [ISR_PROFILE_CAN_TX] = {40, 20},
+};
+
+uint64_t host_isr_cycles = 0;
+
+// Own generator, so the costs don't disturb the sequence a harness gets from rand()
+static uint32_t lcg = 1;
+
+static uint16_t spread(uint16_t max) {
+    lcg = lcg * 1103515245 + 12345;
+    return (lcg >> 16) % (max + 1);
+}
+
+static void spend(uint16_t cycles) {
+    TMR3 += cycles;
+    host_isr_cycles += cycles;
+}
+
+void host_isr_run(isr_profile_branch branch, void (*handler)(void)) {
+    // The hardware turns interrupts off for the handler. They can already be off when the model
+    // runs it to wake the CPU from SLEEP, which on the board it would only run after.
+    bool gie = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    spend(CONTEXT_CYCLES);
+    ISR_PROFILE_ENTER();
+
+    ISR_PROFILE_BEGIN();
+    handler();
+    spend(costs[branch].base + spread(costs[branch].spread));
+    ISR_PROFILE_END(branch);
+
+    spend(DISPATCH_CYCLES);
+    ISR_PROFILE_EXIT();
+    spend(CONTEXT_CYCLES);
+    INTCON0bits.GIE = gie;
+}
@@ -0,0 +1,18 @@
+#ifndef HOST_ISR_H
+#define HOST_ISR_H
+
+// Host model of main.c's interrupt handler running one of its branches. The host can't time the
+// firmware as the board runs it, so Timer3 is moved on by a modelled cost for each branch
+// instead, and with ISR_PROFILE the profiler measures that.
+
+#include <stdint.h>
+
+#include "isr_profile.h"
+
+// Instruction cycles spent in interrupts so far, context save and restore included
+extern uint64_t host_isr_cycles;
+
+// Enters the handler, runs handler() as the given branch and returns from it
+void host_isr_run(isr_profile_branch branch, void (*handler)(void));
+
+#endif /* HOST_ISR_H */
@@ -0,0 +1,165 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include <xc.h>
+
+#include "can_tx.h"
+#include "pps.h"
+#include "timebase.h"
+
+#include "host_isr.h"
+#include "host_timer.h"
+
+// Timer1 clock, Fosc/4/8
+#define TICKS_PER_ns 1.5e-3
+
+double host_osc_error_ppm = 0;
+
+bool host_pps_enabled = false;
+double host_pps_offset_ns = 0;
+double host_pps_jitter_ns = 0;
+
+double host_external_ns = INFINITY;
+void (*host_external_event)(void) = NULL;
+
+static double now_ns = 0;
+static double ticks = 0; // since reset, with the fraction of the tick in progress
+static double next_pps_ns = 0;
+static int32_t pps_second = 0;
+
+static double tick_rate(void) {
+    return TICKS_PER_ns * (1 + host_osc_error_ppm * 1e-6);
+}
+
+static void schedule_pps(void) {
+    // Count seconds rather than derive them from now_ns, which can round back onto the same edge
+    double jitter = host_pps_jitter_ns * (2.0 * rand() / RAND_MAX - 1);
+    next_pps_ns = ++pps_second * 1e9 + host_pps_offset_ns + jitter;
+}
+
+void host_clock_reset(void) {
+    now_ns = 0;
+    ticks = 0;
+    TMR1 = 0;
+    pps_second = 0;
+    schedule_pps();
+}
+
+double host_clock_now_ns(void) {
+    return now_ns;
+}
+
+static void advance_to(double t_ns) {
+    if (T1CONbits.ON) {
+        double whole_before = floor(ticks);
+        ticks += (t_ns - now_ns) * tick_rate();
+        TMR1 += (uint16_t)(uint64_t)(floor(ticks) - whole_before);
+    }
+    now_ns = t_ns;
+}
+
+// Timer1 tick, counted from reset, at which it next equals ccpr
+static double match_ticks(uint16_t ccpr) {
+    uint16_t to_match = ccpr - TMR1;
+    return floor(ticks) + (to_match ? to_match : 65536);
+}
+
+// Raises the interrupt of each compare that matches Timer1 as it now stands
+static void compare_match(void) {
+    if (CCP2CONbits.EN && CCPR2 == TMR1) {
+        PIR4bits.CCP2IF = 1;
+        if (PIE4bits.CCP2IE) {
+            host_isr_run(ISR_PROFILE_TIMEBASE, timebase_handle_interrupt);
+            PIR4bits.CCP2IF = 0;
+        }
+    }
+    if (CCP3CONbits.EN && PIE4bits.CCP3IE && CCPR3 == TMR1) {
+        PIR4bits.CCP3IF = 1;
+        host_isr_run(ISR_PROFILE_CAN_TX, can_tx_handle_gap_interrupt);
+        PIR4bits.CCP3IF = 0;
+    }
+}
+
+// Runs the model on to whichever comes first of limit_ns and the next event, and handles that
+static void run_next_event(double limit_ns) {
+    double event_ns = limit_ns;
+    double event_ticks = 0;
+    uint16_t event_ccpr = 0;
+    bool compare = false;
+    bool pps = false;
+    bool external = false;
+
+    if (T1CONbits.ON) {
+        // CCP3 is only modelled while its interrupt is on, as nothing polls its flag
+        bool ccp3 = CCP3CONbits.EN && PIE4bits.CCP3IE;
+        if (CCP2CONbits.EN || ccp3) {
+            event_ccpr = CCP2CONbits.EN ? CCPR2 : CCPR3;
+            if (CCP2CONbits.EN && ccp3 && match_ticks(CCPR3) < match_ticks(CCPR2)) {
+                event_ccpr = CCPR3;
+            }
+            event_ticks = match_ticks(event_ccpr);
+            double match_ns = now_ns + (event_ticks - ticks) / tick_rate();
+            if (match_ns <= event_ns) {
+                event_ns = match_ns;
+                compare = true;
+            }
+        }
+    }
+    if (next_pps_ns <= event_ns) {
+        event_ns = next_pps_ns;
+        pps = true;
+    }
+    // After anything else at the same time
+    if (host_external_ns < event_ns) {
+        event_ns = host_external_ns;
+        pps = false;
+        external = true;
+    }
+    if (isinf(event_ns)) {
+        abort(); // asleep with nothing to wake it
+    }
+
+    advance_to(event_ns);
+
+    // Something else on the same tick as the match, which a PPS edge every whole second is
+    // without offset or jitter, mustn't step Timer1 over it
+    if (compare && ((!pps && !external) || ticks >= event_ticks)) {
+        // Land exactly on the tick, whatever the rounding
+        ticks = event_ticks;
+        TMR1 = event_ccpr;
+        compare_match();
+    }
+    if (pps) {
+        // With PPS off the receiver's seconds still go by, just without an edge
+        if (host_pps_enabled && CCP1CONbits.EN) {
+            CCPR1 = TMR1;
+            PIR4bits.CCP1IF = 1;
+            if (PIE4bits.CCP1IE) {
+                host_isr_run(ISR_PROFILE_PPS, pps_handle_interrupt);
+                PIR4bits.CCP1IF = 0;
+            }
+        }
+        schedule_pps();
+    }
+    if (external) {
+        host_external_event();
+    }
+}
+
+void host_clock_run(double true_ns) {
+    while (now_ns < true_ns) {
+        run_next_event(true_ns);
+    }
+}
+
+void host_clock_sleep(void) {
+    uint64_t isr_cycles = host_isr_cycles;
+    while (host_isr_cycles == isr_cycles) {
+        run_next_event(INFINITY);
+    }
+}
+
+void host_set_millis(uint32_t ms) {
+    // A little past, so rounding can't leave the interrupt for that ms undelivered
+    host_clock_run(ms * 1e6 + 1);
+}
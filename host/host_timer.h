@@ -0,0 +1,43 @@
+#ifndef HOST_TIMER_H
+#define HOST_TIMER_H
+
+// Host model of the board's oscillator, Timer1 and the receiver's PPS output. Time only moves
+// when the harness runs the model forward, which keeps replays deterministic. As it goes, the
+// model raises the CCP2 and CCP3 compare and CCP1 capture interrupts the way the hardware would
+// and runs their handlers, as main.c's interrupt handler does.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Error of the oscillator Timer1 runs from against true time, parts per million. The harness can
+// change it between runs.
+extern double host_osc_error_ppm;
+
+// PPS edges at every whole true second, displaced by host_pps_offset_ns plus a uniformly
+// distributed jitter of up to host_pps_jitter_ns either way
+extern bool host_pps_enabled;
+extern double host_pps_offset_ns;
+extern double host_pps_jitter_ns;
+
+// Something outside the clock model, such as a byte arriving on the UART, that happens at
+// host_external_ns true time. The model calls host_external_event() then, which sets the time of
+// the next one, or INFINITY for none. None to begin with.
+extern double host_external_ns;
+extern void (*host_external_event)(void);
+
+// Power on: true time and Timer1 back to 0
+void host_clock_reset(void);
+
+// Runs the model forward to true_ns
+void host_clock_run(double true_ns);
+
+double host_clock_now_ns(void);
+
+// The CPU is asleep: runs the model on until an interrupt handler has run. SLEEP() in xc.h.
+void host_clock_sleep(void);
+
+// Runs the model forward to ms of true time. With no oscillator error and timebase_init() run at
+// true time 0, millis() then reads ms.
+void host_set_millis(uint32_t ms);
+
+#endif /* HOST_TIMER_H */
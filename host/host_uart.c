@@ -0,0 +1,64 @@
+#include <stddef.h>
+
+#include <xc.h>
+
+#include "gps_general.h"
+#include "uart_rx.h"
+
+#include "host_dma.h"
+#include "host_isr.h"
+#include "host_uart.h"
+
+uint32_t host_uart_baud = UART_DEFAULT_BAUD;
+void (*host_uart_tx_hook)(uint8_t byte) = NULL;
+uint8_t host_uart_irq_latency = 0;
+
+void uart_init(void) {
+    host_uart_baud = UART_DEFAULT_BAUD;
+    uart_rx_init();
+#if UART_RX_DMA
+    host_dma_load();
+#endif
+}
+
+void uart_set_baud(uint32_t baud) {
+    host_uart_baud = baud;
+}
+
+void uart_write_byte(uint8_t byte) {
+    if (host_uart_tx_hook) {
+        host_uart_tx_hook(byte);
+    }
+}
+
+// Transmission is instantaneous on the host
+bool uart_tx_done(void) {
+    return true;
+}
+
+#if !UART_RX_DMA
+static void push_rx(void) {
+    uart_rx_push(U1RXB);
+}
+#endif
+
+void host_uart_receive(uint8_t byte) {
+    U1RXB = byte;
+
+#if UART_RX_DMA
+    static uint8_t pending = 0;
+
+    host_dma_trigger(HOST_IRQ_U1RX);
+    if (PIE2bits.DMA1SCNTIE == 1 && PIR2bits.DMA1SCNTIF == 1) {
+        if (pending++ >= host_uart_irq_latency) {
+            host_isr_run(ISR_PROFILE_UART_RX, uart_rx_handle_interrupt);
+            PIR2bits.DMA1SCNTIF = 0;
+            pending = 0;
+        }
+    }
+#else
+    if (PIE3bits.U1RXIE == 1) {
+        host_isr_run(ISR_PROFILE_UART_RX, push_rx);
+    }
+#endif
+}
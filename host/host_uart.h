@@ -0,0 +1,23 @@
+#ifndef HOST_UART_H
+#define HOST_UART_H
+
+// Host side of the UART functions in gps_general.c. Bytes the firmware writes are handed to
+// whatever is hooked up as the far end, and bytes from the far end go in through
+// host_uart_receive().
+
+#include <stdint.h>
+
+extern uint32_t host_uart_baud;
+
+// Called for every byte the firmware transmits, at host_uart_baud
+extern void (*host_uart_tx_hook)(uint8_t byte);
+
+// Bytes that arrive after the receive interrupt flag is raised before its handler runs. Lets a
+// harness open up the window where DMA1 has moved on but the interrupt is still pending.
+extern uint8_t host_uart_irq_latency;
+
+// A byte has arrived on RX. Goes through DMA1 or the receive interrupt, whichever uart_rx.c
+// set up, and runs the same handler main.c's interrupt handler would.
+void host_uart_receive(uint8_t byte);
+
+#endif /* HOST_UART_H */
@@ -0,0 +1,51 @@
+#include <xc.h>
+
+volatile uint8_t LATB1, LATB2;
+volatile uint8_t LATC2, LATC7;
+volatile uint8_t TRISB1, TRISB2;
+volatile uint8_t TRISC0, TRISC1, TRISC2, TRISC3, TRISC4;
+volatile uint8_t ANSELC1, ANSELC7;
+volatile uint8_t RC0PPS, CANRXPPS, U1RXPPS;
+
+volatile uint8_t U1RXB;
+volatile uint8_t U1BRGH, U1BRGL, U1CON1;
+volatile U1CON0bits_t U1CON0bits;
+volatile U1CON2bits_t U1CON2bits;
+volatile U1ERRIRbits_t U1ERRIRbits;
+volatile U1ERRIEbits_t U1ERRIEbits;
+
+volatile uint16_t TMR1, CCPR1, CCPR2, CCPR3;
+volatile uint8_t T1CLK, CCP1PPS, ANSELC4;
+volatile T1CONbits_t T1CONbits;
+volatile CCPTMRS0bits_t CCPTMRS0bits;
+volatile CCP1CONbits_t CCP1CONbits;
+volatile CCP2CONbits_t CCP2CONbits;
+volatile CCP3CONbits_t CCP3CONbits;
+
+volatile uint16_t TMR3;
+volatile uint8_t T3CLK;
+volatile T3CONbits_t T3CONbits;
+
+volatile uintptr_t DMA1SSA, DMA1DSA;
+volatile uint16_t DMA1SSZ, DMA1DSZ, DMA1SCNT, DMA1DCNT;
+volatile uint8_t DMA1SIRQ;
+volatile DMA1CON0bits_t DMA1CON0bits;
+volatile DMA1CON1bits_t DMA1CON1bits;
+
+volatile uint8_t DMA1PR, ISRPR, MAINPR, PRLOCK;
+volatile PRLOCKbits_t PRLOCKbits;
+
+volatile uint8_t PIR5;
+volatile PIR5bits_t PIR5bits;
+volatile PIE5bits_t PIE5bits;
+volatile PIR2bits_t PIR2bits;
+volatile PIE2bits_t PIE2bits;
+volatile PIR4bits_t PIR4bits;
+volatile PIE4bits_t PIE4bits;
+volatile PIR3bits_t PIR3bits;
+volatile PIE3bits_t PIE3bits;
+// Interrupts on, as main() leaves them once the board is set up
+volatile INTCON0bits_t INTCON0bits = {.GIE = 1};
+
+volatile OSCFRQbits_t OSCFRQbits;
+volatile CPUDOZEbits_t CPUDOZEbits;
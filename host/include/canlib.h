@@ -0,0 +1,123 @@
+#ifndef HOST_CANLIB_H
+#define HOST_CANLIB_H
+
+// Host stand-in for canlib. Message builders keep canlib's signatures and pack
+// their arguments into the frame so a harness can decode what was sent;
+// txb_enqueue() records frames into a log instead of a transmit pool.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t sid;
+    uint8_t data_len;
+    uint8_t data[8];
+} can_msg_t;
+
+typedef enum {
+    PRIO_HIGHEST = 0,
+    PRIO_HIGH,
+    PRIO_MEDIUM,
+    PRIO_LOW,
+} can_msg_prio_t;
+
+typedef enum {
+    MSG_GENERAL_BOARD_STATUS = 0x001,
+    MSG_RESET_CMD,
+    MSG_DEBUG_RAW,
+    MSG_SENSOR_ANALOG,
+    MSG_GPS_TIMESTAMP,
+    MSG_GPS_LATITUDE,
+    MSG_GPS_LONGITUDE,
+    MSG_GPS_ALTITUDE,
+    MSG_GPS_INFO,
+    MSG_LEDS_ON,
+    MSG_LEDS_OFF,
+} can_msg_type_t;
+
+typedef enum {
+    SENSOR_5V_CURR = 0,
+} can_analog_sensor_id_t;
+
+typedef struct {
+    uint8_t brp;
+    uint8_t sjw;
+    uint8_t sam;
+    uint8_t seg1ph;
+    uint8_t seg2ph;
+    uint8_t prseg;
+    bool btlmode;
+} can_timing_t;
+
+#define E_5V_OVER_CURRENT_OFFSET 0
+
+bool build_general_board_status_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint32_t general_error_bitfield,
+    uint16_t board_specific_error_bitfield, can_msg_t *output
+);
+// payload is 6 bytes
+bool build_debug_raw_msg(
+    can_msg_prio_t prio, uint16_t timestamp, const uint8_t *payload, can_msg_t *output
+);
+bool build_analog_data_msg(
+    can_msg_prio_t prio, uint16_t timestamp, can_analog_sensor_id_t sensor_id, uint16_t sensor_data,
+    can_msg_t *output
+);
+bool build_gps_time_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t hrs, uint8_t mins, uint8_t secs, uint8_t dsecs,
+    can_msg_t *output
+);
+bool build_gps_lat_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t degrees, uint8_t minutes, uint16_t dminutes,
+    uint8_t direction, can_msg_t *output
+);
+bool build_gps_lon_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t degrees, uint8_t minutes, uint16_t dminutes,
+    uint8_t direction, can_msg_t *output
+);
+bool build_gps_alt_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint16_t altitude, uint8_t daltitude, uint8_t units,
+    can_msg_t *output
+);
+bool build_gps_info_msg(
+    can_msg_prio_t prio, uint16_t timestamp, uint8_t num_sat, uint8_t quality, can_msg_t *output
+);
+
+uint16_t get_message_type(const can_msg_t *msg);
+bool check_board_need_reset(const can_msg_t *msg);
+
+// Without txb_init() frames are only logged. With it they're also queued, and txb_heartbeat()
+// hands them to can_send as can_send_rdy allows, as on the board.
+void txb_init(
+    void *pool, size_t pool_size, void (*can_send)(const can_msg_t *), bool (*can_send_rdy)(void)
+);
+bool txb_enqueue(const can_msg_t *msg);
+void txb_heartbeat(void);
+
+// Loads the one hardware transmit buffer. A harness modelling the bus takes the frame from
+// host_can_txb and clears host_can_txb_full once it has been sent.
+void can_send(const can_msg_t *msg);
+bool can_send_rdy(void);
+extern can_msg_t host_can_txb;
+extern bool host_can_txb_full;
+
+// The frame in host_can_txb has been sent. Empties the buffer and raises TXB0's interrupt, running
+// its handler as main.c's interrupt handler would.
+void host_can_tx_complete(void);
+
+// Frames enqueued since the last host_can_reset(), oldest first
+#define HOST_CAN_LOG_SIZE 64
+extern can_msg_t host_can_log[HOST_CAN_LOG_SIZE];
+extern size_t host_can_log_len;
+extern uint32_t host_can_enqueued;
+
+void host_can_reset(void);
+
+// Number of frames of one message type enqueued since the last host_can_reset()
+uint32_t host_can_count(can_msg_type_t type);
+
+// Frames waiting in the transmit queue after txb_init()
+size_t host_can_queued(void);
+
+#endif /* HOST_CANLIB_H */
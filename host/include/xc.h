@@ -0,0 +1,184 @@
+#ifndef HOST_XC_H
+#define HOST_XC_H
+
+// Host stand-in for the XC8 device header. Only the SFRs and intrinsics the
+// firmware sources touch are declared here; each one is a plain global defined
+// in host_xc.c so tests can poke and inspect them.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h> // XC8 pulls strtol() in implicitly, gcc does not
+
+// Port latches, direction and analog select bits
+extern volatile uint8_t LATB1, LATB2;
+extern volatile uint8_t LATC2, LATC7;
+extern volatile uint8_t TRISB1, TRISB2;
+extern volatile uint8_t TRISC0, TRISC1, TRISC2, TRISC3, TRISC4;
+extern volatile uint8_t ANSELC1, ANSELC7;
+extern volatile uint8_t RC0PPS, CANRXPPS, U1RXPPS;
+
+// UART1
+extern volatile uint8_t U1RXB;
+extern volatile uint8_t U1BRGH, U1BRGL, U1CON1;
+typedef struct {
+    uint8_t BRGS;
+    uint8_t MODE;
+    uint8_t RXEN;
+    uint8_t TXEN;
+} U1CON0bits_t;
+extern volatile U1CON0bits_t U1CON0bits;
+typedef struct {
+    uint8_t RUNOVF;
+} U1CON2bits_t;
+extern volatile U1CON2bits_t U1CON2bits;
+typedef struct {
+    uint8_t FERIF;
+    uint8_t U1FERIF;
+    uint8_t RXFOIF;
+} U1ERRIRbits_t;
+extern volatile U1ERRIRbits_t U1ERRIRbits;
+typedef struct {
+    uint8_t FERIE;
+    uint8_t RXFOIE;
+} U1ERRIEbits_t;
+extern volatile U1ERRIEbits_t U1ERRIEbits;
+
+// Timer1, CCP1, CCP2 and CCP3
+extern volatile uint16_t TMR1, CCPR1, CCPR2, CCPR3;
+extern volatile uint8_t T1CLK, CCP1PPS, ANSELC4;
+typedef struct {
+    uint8_t CKPS;
+    uint8_t RD16;
+    uint8_t ON;
+} T1CONbits_t;
+extern volatile T1CONbits_t T1CONbits;
+typedef struct {
+    uint8_t C1TSEL;
+    uint8_t C2TSEL;
+    uint8_t C3TSEL;
+} CCPTMRS0bits_t;
+extern volatile CCPTMRS0bits_t CCPTMRS0bits;
+typedef struct {
+    uint8_t MODE;
+    uint8_t EN;
+} CCP1CONbits_t;
+extern volatile CCP1CONbits_t CCP1CONbits;
+typedef struct {
+    uint8_t MODE;
+    uint8_t EN;
+} CCP2CONbits_t;
+extern volatile CCP2CONbits_t CCP2CONbits;
+typedef struct {
+    uint8_t MODE;
+    uint8_t EN;
+} CCP3CONbits_t;
+extern volatile CCP3CONbits_t CCP3CONbits;
+
+// Timer3, for isr_profile.c
+extern volatile uint16_t TMR3;
+extern volatile uint8_t T3CLK;
+typedef struct {
+    uint8_t CKPS;
+    uint8_t RD16;
+    uint8_t ON;
+} T3CONbits_t;
+extern volatile T3CONbits_t T3CONbits;
+
+// DMA1. Address registers are wide enough to hold a host pointer.
+extern volatile uintptr_t DMA1SSA, DMA1DSA;
+extern volatile uint16_t DMA1SSZ, DMA1DSZ, DMA1SCNT, DMA1DCNT;
+extern volatile uint8_t DMA1SIRQ;
+typedef struct {
+    uint8_t EN;
+    uint8_t SIRQEN;
+} DMA1CON0bits_t;
+extern volatile DMA1CON0bits_t DMA1CON0bits;
+typedef struct {
+    uint8_t DMODE;
+    uint8_t DSTP;
+    uint8_t SMR;
+    uint8_t SMODE;
+    uint8_t SSTP;
+} DMA1CON1bits_t;
+extern volatile DMA1CON1bits_t DMA1CON1bits;
+
+// System arbiter
+extern volatile uint8_t DMA1PR, ISRPR, MAINPR, PRLOCK;
+typedef struct {
+    uint8_t PRLOCKED;
+} PRLOCKbits_t;
+extern volatile PRLOCKbits_t PRLOCKbits;
+
+// Interrupt controller. PIR5 is only read whole by main.c, so it's kept apart from PIR5bits.
+extern volatile uint8_t PIR5;
+typedef struct {
+    uint8_t TXB0IF;
+} PIR5bits_t;
+extern volatile PIR5bits_t PIR5bits;
+typedef struct {
+    uint8_t TXB0IE;
+} PIE5bits_t;
+extern volatile PIE5bits_t PIE5bits;
+typedef struct {
+    uint8_t DMA1SCNTIF;
+    uint8_t DMA1DCNTIF;
+} PIR2bits_t;
+extern volatile PIR2bits_t PIR2bits;
+typedef struct {
+    uint8_t DMA1SCNTIE;
+    uint8_t DMA1DCNTIE;
+} PIE2bits_t;
+extern volatile PIE2bits_t PIE2bits;
+typedef struct {
+    uint8_t CCP1IF;
+    uint8_t CCP2IF;
+    uint8_t CCP3IF;
+} PIR4bits_t;
+extern volatile PIR4bits_t PIR4bits;
+typedef struct {
+    uint8_t CCP1IE;
+    uint8_t CCP2IE;
+    uint8_t CCP3IE;
+} PIE4bits_t;
+extern volatile PIE4bits_t PIE4bits;
+typedef struct {
+    uint8_t U1RXIF;
+    uint8_t U1EIF;
+    uint8_t TMR0IF;
+} PIR3bits_t;
+extern volatile PIR3bits_t PIR3bits;
+typedef struct {
+    uint8_t U1RXIE;
+    uint8_t U1EIE;
+    uint8_t TMR0IE;
+} PIE3bits_t;
+extern volatile PIE3bits_t PIE3bits;
+typedef struct {
+    uint8_t GIE;
+} INTCON0bits_t;
+extern volatile INTCON0bits_t INTCON0bits;
+
+// Oscillator
+typedef struct {
+    uint8_t FRQ;
+} OSCFRQbits_t;
+extern volatile OSCFRQbits_t OSCFRQbits;
+
+// Power saving
+typedef struct {
+    uint8_t IDLEN;
+} CPUDOZEbits_t;
+extern volatile CPUDOZEbits_t CPUDOZEbits;
+
+// Runs the clock model on until an interrupt handler has run, as host_timer.c provides
+void host_clock_sleep(void);
+
+#define __interrupt(...)
+#define __delay_ms(x) ((void)(x))
+#define __delay_us(x) ((void)(x))
+#define CLRWDT() ((void)0)
+#define RESET() abort()
+#define NOP() ((void)0)
+#define SLEEP() host_clock_sleep()
+
+#endif /* HOST_XC_H */
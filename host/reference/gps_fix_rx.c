@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include "canlib.h"
+
+#include "gps_module.h"
+#include "gps_msgs.h"
+
+#include "gps_fix_rx.h"
+
+#define ALL_FRAMES ((1 << GPS_FIX_FRAMES) - 1)
+
+void gps_fix_rx_init(gps_fix_rx_t *rx) {
+    memset(rx, 0, sizeof(*rx));
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+bool gps_fix_rx_handle(gps_fix_rx_t *rx, const can_msg_t *msg, gps_fix_rx_fix_t *fix) {
+    if (get_message_type(msg) != MSG_DEBUG_RAW) {
+        return false;
+    }
+
+    // The id is where it is in every GPS message, the rest of the frame is the fix's
+    const uint8_t *data = msg->data;
+    uint8_t frame = data[2] - GPS_MSG_FIX_TIME;
+    if (data[2] < GPS_MSG_FIX_TIME || frame >= GPS_FIX_FRAMES) {
+        return false;
+    }
+
+    // Frames of a fix go out in order, but one can be overwritten on the board before it's sent
+    if (rx->have != 0 && data[0] != rx->fix.seq) {
+        rx->dropped++;
+        rx->have = 0;
+    }
+    if (rx->have == 0) {
+        rx->alt_bits = 0;
+        rx->fix.seq = data[0];
+    }
+
+    uint32_t value = read_u32(data + 3);
+    switch (data[2]) {
+        case GPS_MSG_FIX_TIME:
+            rx->fix.quality = data[1] & GPS_FIX_INFO_QUALITY_MASK;
+            rx->fix.constellation = data[1] >> GPS_FIX_INFO_CONSTELLATION_SHIFT;
+            rx->fix.tow = value;
+            rx->fix.numsat = data[7];
+            break;
+
+        case GPS_MSG_FIX_LAT:
+            rx->fix.lat = (int32_t)value;
+            rx->alt_bits |= ((uint32_t)data[1] << 24) | ((uint32_t)data[7] << 16);
+            break;
+
+        default:
+            rx->fix.lon = (int32_t)value;
+            rx->alt_bits |= ((uint32_t)data[1] << 8) | data[7];
+            break;
+    }
+    rx->have |= 1 << frame;
+
+    if (rx->have != ALL_FRAMES) {
+        return false;
+    }
+    rx->fix.alt = (int32_t)rx->alt_bits;
+    *fix = rx->fix;
+    rx->have = 0;
+    rx->fixes++;
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef GPS_FIX_RX_H
+#define GPS_FIX_RX_H
+
+// Reference for the receiving side of the compact fix encoding, see gps_msgs.h. Other boards can
+// take this as it is or check theirs against it with host/sim_compact_fix.c.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "canlib.h"
+
+typedef struct {
+    uint8_t seq;
+    uint32_t tow; // GPS time of week in ms, GPS_TOW_UNKNOWN if the board doesn't know the date
+    uint8_t quality; // GGA quality indicator
+    uint8_t constellation; // gnss_constellation
+    uint8_t numsat;
+    int32_t lat; // 1e-7 degrees, north positive
+    int32_t lon; // 1e-7 degrees, east positive
+    int32_t alt; // above mean sea level, decimetres
+} gps_fix_rx_fix_t;
+
+typedef struct {
+    uint8_t have; // frames of the fix being assembled, a bit per frame
+    uint32_t alt_bits;
+    gps_fix_rx_fix_t fix;
+
+    uint32_t fixes; // completed
+    uint32_t dropped; // incomplete when a frame for a later fix came
+} gps_fix_rx_t;
+
+void gps_fix_rx_init(gps_fix_rx_t *rx);
+
+// Any frame received. Frames other than the compact fix's are ignored. True once all three frames
+// of a fix have come, which is then in *fix.
+bool gps_fix_rx_handle(gps_fix_rx_t *rx, const can_msg_t *msg, gps_fix_rx_fix_t *fix);
+
+#endif /* GPS_FIX_RX_H */
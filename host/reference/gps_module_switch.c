@@ -0,0 +1,300 @@
+// Snapshot of gps_module.c's nested-switch GGA parser, kept so the host benchmarks can compare
+// the table-driven parser against it. Not part of the firmware build.
+
+#include <string.h>
+
+#include <xc.h>
+
+#include "canlib.h"
+#include "timebase.h"
+
+#include "can_tx.h"
+#include "gps_general.h"
+#include "gps_module.h"
+#include "nmea_convert.h"
+
+// Order matters for this enum, matches the order of GPGGA fields
+typedef enum {
+    P_IDLE = 0,
+    P_MSG_TYPE,
+    P_TIMESTAMP,
+    P_LATITUDE,
+    P_LATITUDE_DIR_NS,
+    P_LONGITUDE,
+    P_LONGITUDE_DIR_EW,
+    P_QUALITY, // Quality Indicator:
+               // 1 = Uncorrected coordinate
+               // 2 = Differentially correct coordinate (e.g., WAAS, DGPS)
+               // 4 = RTK Fix coordinate (centimeter precision)
+               // 5 = RTK Float (decimeter precision.
+               // 6 = Dead reckoning mode
+    P_NUM_SATELLITES,
+    P_HDOP, // horizontal dilution of precision
+    P_ALTITUDE,
+    P_ALTITUDE_UNITS,
+    P_UNDULATION, // geoid-to-ellipsoid separation
+    P_UNDULATION_UNITS,
+    P_AGE,
+    P_DIFF_REF_ID,
+    P_CHECKSUM,
+    P_STOP,
+} parser_state;
+
+typedef struct {
+    nmea_number_t value;
+    char dir;
+} parser_coord;
+
+typedef struct {
+    char indicator;
+    uint8_t numsat;
+} parser_qual;
+
+static struct {
+    parser_state state;
+    uint8_t checksum;
+    uint8_t index;
+    char msg_type[5];
+    nmea_number_t utc;
+    parser_coord lat;
+    parser_coord lon;
+    parser_qual qual;
+    parser_coord alt;
+    uint8_t exp_checksum;
+} parser;
+
+void gps_init(void) {
+    // Set port C2 as output pin (~HWR)
+    TRISC2 = 0;
+
+    // Set C2 to high because it's active low
+    LATC2 = 1;
+
+    // Set C3 to input (FIX)
+    TRISC3 = 1;
+
+    // Set C4 to input (PPS)
+    TRISC4 = 1;
+}
+
+// converts a hex char to integer
+uint8_t hextoint(char hex) {
+    if ('0' <= hex && hex <= '9') {
+        return hex - '0';
+    }
+    if ('a' <= hex && hex <= 'f') {
+        return hex - 'a' + 10;
+    }
+    if ('A' <= hex && hex <= 'F') {
+        return hex - 'A' + 10;
+    }
+    return 0;
+}
+
+void enqueue_can_msgs_utc(uint32_t timestamp) {
+    can_msg_t msg_utc;
+
+    // message format: hhmmss.sss
+    // only the first 2 fractional digits are sent, so that dsec fits within a byte
+    build_gps_time_msg(
+        PRIO_HIGH,
+        timestamp,
+        (uint8_t)nmea_number_int(&parser.utc, 4, 2),
+        (uint8_t)nmea_number_int(&parser.utc, 2, 2),
+        (uint8_t)nmea_number_int(&parser.utc, 0, 2),
+        (uint8_t)nmea_number_frac(&parser.utc, 2),
+        &msg_utc
+    );
+    can_tx_enqueue(&msg_utc);
+}
+
+void enqueue_can_msgs_lat(uint32_t timestamp) {
+    can_msg_t msg_lat;
+
+    // messge format: ddmm.mmmm
+    build_gps_lat_msg(
+        PRIO_HIGH,
+        timestamp,
+        (uint8_t)nmea_number_int(&parser.lat.value, 2, 3),
+        (uint8_t)nmea_number_int(&parser.lat.value, 0, 2),
+        nmea_number_frac(&parser.lat.value, 4),
+        parser.lat.dir,
+        &msg_lat
+    );
+    can_tx_enqueue(&msg_lat);
+}
+
+void enqueue_can_msgs_lon(uint32_t timestamp) {
+    can_msg_t msg_lon;
+
+    // message format: dddmm.mmmm
+    build_gps_lon_msg(
+        PRIO_HIGH,
+        timestamp,
+        (uint8_t)nmea_number_int(&parser.lon.value, 2, 3),
+        (uint8_t)nmea_number_int(&parser.lon.value, 0, 2),
+        nmea_number_frac(&parser.lon.value, 4),
+        parser.lon.dir,
+        &msg_lon
+    );
+    can_tx_enqueue(&msg_lon);
+}
+
+void enqueue_can_msgs_alt(uint32_t timestamp) {
+    can_msg_t msg_alt;
+
+    // message format: just a normal decimal number, only the first 2 fractional digits are sent
+    // so that they fit within a byte
+    build_gps_alt_msg(
+        PRIO_HIGH,
+        millis(),
+        nmea_number_int(&parser.alt.value, 0, NMEA_INT_DIGITS),
+        (uint8_t)nmea_number_frac(&parser.alt.value, 2),
+        parser.alt.dir,
+        &msg_alt
+    );
+    can_tx_enqueue(&msg_alt);
+}
+
+void enqueue_can_msgs_info(uint32_t timestamp) {
+    can_msg_t msg_info;
+
+    uint8_t numsat = parser.qual.numsat;
+    uint8_t quality = parser.qual.indicator - '0';
+
+    build_gps_info_msg(PRIO_HIGH, timestamp, numsat, quality, &msg_info);
+    can_tx_enqueue(&msg_info);
+}
+
+void reset_parser(void) {
+    memset(&parser, 0, sizeof(parser));
+}
+
+void gps_handle_byte(uint8_t byte) {
+    switch (byte) {
+        case '$':
+            // Start of message
+            reset_parser();
+            parser.state = P_MSG_TYPE;
+            break;
+
+        case ',':
+            // Field separater
+            if (parser.state == P_IDLE) {
+                break;
+            }
+            if (parser.state == P_MSG_TYPE) {
+                if (strncmp(parser.msg_type, "GPGGA", 5) != 0) {
+                    // Not a GPGGA signal, then we don't care
+                    parser.state = P_STOP;
+                    return;
+                } else {
+                    LED_2_ON();
+                }
+            }
+
+            parser.state++;
+            parser.index = 0;
+            parser.checksum ^= byte;
+
+            break;
+
+        case '*':
+            // Checksum indicator
+            if (parser.state == P_IDLE) {
+                break;
+            }
+            parser.state = P_CHECKSUM;
+            parser.index = 0;
+            break;
+
+        case '\r':
+        case '\n': {
+            // End of message
+            if (parser.state == P_CHECKSUM && parser.index == 2) {
+                if (parser.checksum == parser.exp_checksum) {
+                    uint32_t timestamp = millis();
+                    enqueue_can_msgs_utc(timestamp);
+                    enqueue_can_msgs_lat(timestamp);
+                    enqueue_can_msgs_lon(timestamp);
+                    enqueue_can_msgs_info(timestamp);
+                    enqueue_can_msgs_alt(timestamp);
+                }
+            }
+
+            parser.state = P_STOP;
+            break;
+        }
+
+        default: {
+// help macro to safely add byte to parser message
+#define APPEND_PARSER_MESSAGE(msg, byte)                                                           \
+    do {                                                                                           \
+        if (parser.index < sizeof(msg))                                                            \
+            msg[parser.index++] = byte;                                                            \
+    } while (0)
+
+            // Parse message fields
+            switch (parser.state) {
+                case P_IDLE:
+                    break;
+                case P_MSG_TYPE:
+                    APPEND_PARSER_MESSAGE(parser.msg_type, byte);
+                    break;
+                case P_TIMESTAMP:
+                    nmea_number_push(&parser.utc, byte);
+                    break;
+                case P_LATITUDE:
+                    nmea_number_push(&parser.lat.value, byte);
+                    break;
+                case P_LONGITUDE:
+                    nmea_number_push(&parser.lon.value, byte);
+                    break;
+                case P_LATITUDE_DIR_NS:
+                    parser.lat.dir = byte;
+                    break;
+                case P_LONGITUDE_DIR_EW:
+                    parser.lon.dir = byte;
+                    break;
+                case P_QUALITY:
+                    parser.qual.indicator = byte;
+                    break;
+                case P_NUM_SATELLITES:
+                    if ('0' <= byte && byte <= '9') {
+                        parser.qual.numsat = parser.qual.numsat * 10 + (byte - '0');
+                    }
+                    break;
+                case P_HDOP:
+                    break;
+                case P_ALTITUDE:
+                    nmea_number_push(&parser.alt.value, byte);
+                    break;
+                case P_ALTITUDE_UNITS:
+                    parser.alt.dir = byte;
+                    break;
+                case P_UNDULATION:
+                case P_UNDULATION_UNITS:
+                case P_AGE:
+                case P_DIFF_REF_ID:
+                    break;
+                case P_CHECKSUM:
+                    if (parser.index < 2) {
+                        parser.exp_checksum = (parser.exp_checksum << 4) | hextoint(byte);
+                        parser.index++;
+                    }
+                    break;
+                case P_STOP:
+                default:
+                    LED_2_OFF();
+                    parser.state = P_IDLE;
+                    break;
+            }
+
+            if (parser.state != P_CHECKSUM) {
+                parser.checksum ^= byte;
+            }
+
+            break;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#include <string.h>
+
+#include "canlib.h"
+
+#include "gps_msgs.h"
+
+#include "time_sync_rx.h"
+
+void time_sync_rx_init(time_sync_rx_t *rx, uint32_t bit_rate) {
+    memset(rx, 0, sizeof(*rx));
+    rx->frame_us = (TIME_SYNC_RX_FRAME_BITS * 1000000ULL + bit_rate / 2) / bit_rate;
+}
+
+static uint64_t utc_since(uint64_t utc_us, uint64_t earlier_utc_us) {
+    return (utc_us + TIME_SYNC_RX_US_PER_DAY - earlier_utc_us) % TIME_SYNC_RX_US_PER_DAY;
+}
+
+static void add_sync(time_sync_rx_t *rx, uint32_t local_us, uint64_t utc_us) {
+    if (rx->syncs > 0 && local_us - rx->local_us[rx->syncs - 1] > TIME_SYNC_RX_MAX_GAP_us) {
+        rx->syncs = 0;
+    }
+    if (rx->syncs == TIME_SYNC_RX_HISTORY) {
+        memmove(rx->local_us, rx->local_us + 1, (TIME_SYNC_RX_HISTORY - 1) * sizeof(uint32_t));
+        memmove(rx->utc_us, rx->utc_us + 1, (TIME_SYNC_RX_HISTORY - 1) * sizeof(uint64_t));
+        rx->syncs--;
+    }
+    rx->local_us[rx->syncs] = local_us;
+    rx->utc_us[rx->syncs] = utc_us;
+    rx->syncs++;
+
+    // Rate from the oldest sync kept, the longest baseline there is
+    if (rx->syncs >= 2) {
+        int64_t local_span = (uint32_t)(local_us - rx->local_us[0]);
+        int64_t utc_span = utc_since(utc_us, rx->utc_us[0]);
+        if (utc_span > 0) {
+            rx->rate_ppb = (int32_t)((local_span - utc_span) * 1000000000 / utc_span);
+        }
+    }
+}
+
+void time_sync_rx_handle(time_sync_rx_t *rx, const can_msg_t *msg, uint32_t local_us) {
+    if (get_message_type(msg) != MSG_DEBUG_RAW) {
+        return;
+    }
+
+    // Payload starts after the two timestamp bytes
+    const uint8_t *payload = msg->data + 2;
+    switch (payload[0]) {
+        case GPS_MSG_TIME_SYNC:
+            rx->sync_pending = true;
+            rx->sync_seq = payload[1];
+            rx->sync_second_of_day =
+                ((uint32_t)payload[2] << 16) | ((uint32_t)payload[3] << 8) | payload[4];
+            rx->sync_local_us = local_us;
+            break;
+
+        case GPS_MSG_TIME_FOLLOW_UP: {
+            // A follow up for a sync that was lost, or one that never had one, is no use
+            if (!rx->sync_pending || payload[1] != rx->sync_seq) {
+                return;
+            }
+            rx->sync_pending = false;
+
+            uint32_t after_edge = ((uint32_t)payload[2] << 24) | ((uint32_t)payload[3] << 16)
+                                  | ((uint32_t)payload[4] << 8) | payload[5];
+
+            // The sync started on the bus after_edge past the second, and was stamped here once
+            // the whole frame was in
+            uint64_t utc_us =
+                (uint64_t)rx->sync_second_of_day * 1000000 + after_edge + rx->frame_us;
+            add_sync(rx, rx->sync_local_us, utc_us % TIME_SYNC_RX_US_PER_DAY);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+bool time_sync_rx_utc(const time_sync_rx_t *rx, uint32_t local_us, uint64_t *utc_us) {
+    if (rx->syncs == 0) {
+        return false;
+    }
+
+    uint8_t last = rx->syncs - 1;
+    // Divided rather than corrected to first order, which is 400 us a second out at 2%
+    int64_t elapsed = (int32_t)(local_us - rx->local_us[last]);
+    elapsed = elapsed * 1000000000 / (1000000000 + rx->rate_ppb);
+
+    *utc_us = (rx->utc_us[last] + TIME_SYNC_RX_US_PER_DAY + elapsed) % TIME_SYNC_RX_US_PER_DAY;
+    return true;
+}
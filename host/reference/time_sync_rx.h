@@ -0,0 +1,52 @@
+#ifndef TIME_SYNC_RX_H
+#define TIME_SYNC_RX_H
+
+// Reference for the receiving side of the GPS board's time sync, see time_sync.h. Other boards
+// can take this as it is or check theirs against it with host/sim_time_sync.c. It needs only a
+// local microsecond clock, read when each frame arrives.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "canlib.h"
+
+#define TIME_SYNC_RX_US_PER_DAY 86400000000ULL
+
+// A standard frame with 8 data bytes is 108 bits plus stuff bits, which depend on its content.
+// This allows for about half of the most there can be.
+#define TIME_SYNC_RX_FRAME_BITS 120
+
+// This board's clock error is measured across up to this many syncs
+#define TIME_SYNC_RX_HISTORY 8
+// Syncs further apart than this start the measurement again
+#define TIME_SYNC_RX_MAX_GAP_us 10000000
+
+typedef struct {
+    uint32_t frame_us; // start of the sync frame to when it's stamped
+
+    // Sync waiting for its follow up
+    bool sync_pending;
+    uint8_t sync_seq;
+    uint32_t sync_second_of_day;
+    uint32_t sync_local_us;
+
+    // Completed syncs, oldest first: local time each sync arrived and UTC at that moment
+    uint8_t syncs;
+    uint32_t local_us[TIME_SYNC_RX_HISTORY];
+    uint64_t utc_us[TIME_SYNC_RX_HISTORY]; // since midnight
+
+    int32_t rate_ppb; // how fast this board's clock runs against UTC
+} time_sync_rx_t;
+
+// bit_rate: of the bus, to know how long the sync frame took
+void time_sync_rx_init(time_sync_rx_t *rx, uint32_t bit_rate);
+
+// Any frame received, with the local time it was stamped on arrival. Frames other than the
+// GPS board's time sync are ignored.
+void time_sync_rx_handle(time_sync_rx_t *rx, const can_msg_t *msg, uint32_t local_us);
+
+// UTC since midnight at a local time, extrapolated from the latest sync. False before the first
+// sync completes.
+bool time_sync_rx_utc(const time_sync_rx_t *rx, uint32_t local_us, uint64_t *utc_us);
+
+#endif /* TIME_SYNC_RX_H */
@@ -0,0 +1,266 @@
+// Sends frames through can_tx.c over a modelled CAN bus. Checks their spacing: no frame is
+// loaded sooner than CAN_TX_MIN_GAP_us after the one before it went out, and none waits longer
+// than the gap, or on the main loop, once one could have gone. Then saturates the bus with other
+// boards' traffic while fixes keep coming, and checks that what's waiting stays bounded and the
+// fixes that go out are fresh.
+//
+// usage: sim_can_tx
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "canlib.h"
+
+#include "can_tx.h"
+#include "timebase.h"
+
+#include "host_timer.h"
+
+#define MAX_FRAMES 4096
+
+// Modelled bus, as in sim_time_sync.c
+#define BIT_RATE 125000
+#define BIT_ns (1e9 / BIT_RATE)
+#define FRAME_BITS 108
+#define MAX_STUFF_BITS 24
+#define INTERFRAME_BITS 3
+
+// A Timer1 tick, for rounding
+#define TICK_ns (1e6 / TIMEBASE_TICKS_PER_ms)
+
+// Frames of a fix, one per slot, as gps_module.c and main.c post them
+#define FIX_FRAMES CAN_TX_SLOTS
+
+typedef struct {
+    const char *name;
+    double length_ns;
+    double osc_error_ppm;
+    double loop_ns; // main loop period
+    int burst_frames; // FIFO frames enqueued at once every burst_ns
+    double burst_ns;
+    double fix_ns; // a fix is posted this often, 0 for none
+    int other_frames; // up to this many of other boards' frames win the bus ahead of each of ours
+    // Limits with the bus saturated
+    size_t max_queued;
+    double max_fix_age_ns;
+} scenario;
+
+static const scenario scenarios[] = {
+    {"burst, fast loop", 300e6, 0, 50e3, 40, 100e6, 0, 0, 0, 0},
+    {"burst, 5 ms loop", 300e6, 0, 5e6, 40, 100e6, 0, 0, 0, 0},
+    {"trickle, 1 ms loop", 300e6, 0, 1e6, 1, 3e6, 0, 0, 0, 0},
+    {"burst, osc 1.5% fast", 300e6, 15000, 50e3, 40, 100e6, 0, 0, 0, 0},
+    {"burst, osc 1.5% slow", 300e6, -15000, 50e3, 40, 100e6, 0, 0, 0, 0},
+    {"20 Hz fixes, saturated", 5e9, 0, 50e3, 1, 500e6, 50e6, 15, 4, 150e6},
+};
+
+static const scenario *sc;
+
+// Every frame made, by id
+static struct {
+    double enqueued_ns;
+    bool fix;
+} made[MAX_FRAMES];
+static int made_count;
+
+// Frames loaded into TXB0, in order
+static struct {
+    uint16_t id;
+    double loaded_ns;
+    double done_ns;
+} sent[MAX_FRAMES];
+static int sent_count;
+
+static struct {
+    bool in_flight;
+    double done_ns;
+    double free_ns;
+} bus;
+
+static uint16_t frame_id(const can_msg_t *msg) {
+    return ((uint16_t)msg->data[2] << 8) | msg->data[3];
+}
+
+// FIFO frames go through sim_send, slots straight to can_send()
+static void sim_send(const can_msg_t *msg) {
+    can_send(msg);
+}
+
+static void note_load(double t_ns) {
+    if (sent_count < MAX_FRAMES) {
+        sent[sent_count].id = frame_id(&host_can_txb);
+        sent[sent_count].loaded_ns = t_ns;
+        sent_count++;
+    }
+}
+
+static bool make(double t_ns, bool fix, can_msg_t *msg) {
+    if (made_count == MAX_FRAMES) {
+        return false;
+    }
+    uint8_t payload[6] = {made_count >> 8, made_count & 0xff};
+    build_debug_raw_msg(PRIO_LOW, millis(), payload, msg);
+    made[made_count].enqueued_ns = t_ns;
+    made[made_count].fix = fix;
+    made_count++;
+    return true;
+}
+
+static void post_fix(double t_ns) {
+    for (int i = 0; i < FIX_FRAMES; i++) {
+        can_msg_t msg;
+        if (make(t_ns, true, &msg)) {
+            can_tx_post(i, &msg);
+        }
+    }
+}
+
+static void bus_start(double t_ns) {
+    if (!host_can_txb_full || bus.in_flight) {
+        return;
+    }
+    note_load(t_ns);
+    double start_ns = t_ns > bus.free_ns ? t_ns : bus.free_ns;
+    // Other boards win arbitration for as many frames as they have waiting
+    int others = sc->other_frames ? rand() % (sc->other_frames + 1) : 0;
+    start_ns += others * (FRAME_BITS + MAX_STUFF_BITS / 2 + INTERFRAME_BITS) * BIT_ns;
+    bus.done_ns = start_ns + (FRAME_BITS + rand() % (MAX_STUFF_BITS + 1)) * BIT_ns;
+    bus.free_ns = bus.done_ns + INTERFRAME_BITS * BIT_ns;
+    bus.in_flight = true;
+}
+
+static bool run(void) {
+    host_osc_error_ppm = sc->osc_error_ppm;
+    host_pps_enabled = false;
+    host_clock_reset();
+    host_can_reset();
+    timebase_init();
+    txb_init(NULL, 0, sim_send, can_send_rdy);
+    can_tx_init();
+
+    made_count = 0;
+    sent_count = 0;
+    bus.in_flight = false;
+    bus.free_ns = 0;
+
+    size_t max_queued = 0;
+    double next_loop_ns = 0;
+    double next_burst_ns = 1e6;
+    double next_fix_ns = 1e6;
+    while (host_clock_now_ns() < sc->length_ns) {
+        // A bit at a time at most, so a frame loaded by an interrupt goes on the bus within a bit
+        // of when it was. Loads are timed to the bit.
+        double next_ns = host_clock_now_ns() + BIT_ns;
+        if (next_loop_ns < next_ns) {
+            next_ns = next_loop_ns;
+        }
+        if (bus.in_flight && bus.done_ns < next_ns) {
+            next_ns = bus.done_ns;
+        }
+        host_clock_run(next_ns);
+        bus_start(next_ns);
+
+        if (bus.in_flight && bus.done_ns <= next_ns) {
+            bus.in_flight = false;
+            sent[sent_count - 1].done_ns = bus.done_ns;
+            host_can_tx_complete();
+            bus_start(next_ns);
+        }
+
+        if (next_ns >= next_loop_ns) {
+            // Frames are made as the main loop goes, never in between
+            while (next_burst_ns <= next_ns) {
+                for (int i = 0; i < sc->burst_frames; i++) {
+                    can_msg_t msg;
+                    if (make(next_ns, false, &msg)) {
+                        can_tx_enqueue(&msg);
+                    }
+                }
+                next_burst_ns += sc->burst_ns;
+            }
+            while (sc->fix_ns && next_fix_ns <= next_ns) {
+                post_fix(next_ns);
+                next_fix_ns += sc->fix_ns;
+            }
+            can_tx_heartbeat();
+            bus_start(next_ns);
+            next_loop_ns += sc->loop_ns;
+
+            if (host_can_queued() > max_queued) {
+                max_queued = host_can_queued();
+            }
+        }
+    }
+
+    // Timer1 runs fast or slow with the oscillator, and the gap with it. A load is seen up to a
+    // bit after it happens.
+    double rate = 1 + sc->osc_error_ppm * 1e-6;
+    double min_gap_ns = CAN_TX_MIN_GAP_us * 1e3 / rate - TICK_ns;
+    double max_gap_ns = CAN_TX_MIN_GAP_us * 1e3 / rate + TICK_ns + BIT_ns;
+
+    // Earliest any frame still to be loaded was made, for each point in the sequence
+    static double waiting_since_ns[MAX_FRAMES];
+    double earliest = INFINITY;
+    for (int i = sent_count - 1; i >= 0; i--) {
+        if (made[sent[i].id].enqueued_ns < earliest) {
+            earliest = made[sent[i].id].enqueued_ns;
+        }
+        waiting_since_ns[i] = earliest;
+    }
+
+    bool ok = sent_count > 0;
+    double shortest_gap_ns = INFINITY;
+    double longest_wait_ns = -INFINITY;
+    double oldest_fix_ns = 0;
+    for (int i = 0; i < sent_count; i++) {
+        double age = sent[i].loaded_ns - made[sent[i].id].enqueued_ns;
+        if (made[sent[i].id].fix && age > oldest_fix_ns) {
+            oldest_fix_ns = age;
+        }
+        if (i == 0) {
+            continue;
+        }
+
+        double gap = sent[i].loaded_ns - sent[i - 1].done_ns;
+        // Something could have gone from when it was made, or once the gap after the last was up
+        double ready = sent[i - 1].done_ns + max_gap_ns;
+        if (waiting_since_ns[i] > ready) {
+            ready = waiting_since_ns[i] + BIT_ns;
+        }
+        double wait = sent[i].loaded_ns - ready;
+
+        if (gap < shortest_gap_ns) {
+            shortest_gap_ns = gap;
+        }
+        if (wait > longest_wait_ns) {
+            longest_wait_ns = wait;
+        }
+        ok &= gap >= min_gap_ns && wait <= 0;
+    }
+
+    printf("%-24s %4d frames, gap at least %6.1f us, transmitter never idle with one waiting%s",
+           sc->name, sent_count, shortest_gap_ns / 1e3, longest_wait_ns <= 0 ? "" : " NOT");
+    if (sc->fix_ns) {
+        // The FIFO build is there for comparison, and isn't held to the limits
+        printf(", up to %zu queued, fixes up to %.0f ms old", max_queued, oldest_fix_ns / 1e6);
+        ok &= !CAN_TX_MAILBOX
+              || (max_queued <= sc->max_queued && oldest_fix_ns <= sc->max_fix_age_ns);
+    }
+    printf(" %s\n", ok ? "ok" : "UNEXPECTED");
+    return ok;
+}
+
+int main(void) {
+    srand(1);
+    printf("minimum gap %u us, GPS messages through %s\n", CAN_TX_MIN_GAP_us,
+           CAN_TX_MAILBOX ? "latest-value slots" : "the FIFO");
+
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        sc = &scenarios[i];
+        ok &= run();
+    }
+    return ok ? 0 : 1;
+}
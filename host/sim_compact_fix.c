@@ -0,0 +1,265 @@
+// Replays recorded receiver logs with fixes sent in canlib's messages and then in the compact
+// encoding, decodes the compact frames with the reference receiver in reference/gps_fix_rx.c,
+// checks every fix against what the canlib messages said, and compares the bus time each
+// encoding takes. Frames are counted bit for bit, stuffing included.
+//
+// usage: sim_compact_fix log...
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "canlib.h"
+
+#include "gps_module.h"
+#include "gps_msgs.h"
+#include "timebase.h"
+
+#include "bench.h"
+#include "host_timer.h"
+#include "reference/gps_fix_rx.h"
+
+#define BIT_RATE 125000
+#define MAX_FIXES 1024
+// Fix rates the bus load is given for
+static const unsigned rates_hz[] = {1, 5, 10, 20};
+
+// A fix as both encodings can give it
+typedef struct {
+    uint32_t second_of_day;
+    uint8_t csec;
+    int32_t lat; // 1e-7 degrees
+    int32_t lon;
+    int32_t alt; // decimetres
+    uint8_t numsat;
+    uint8_t quality;
+} sim_fix;
+
+typedef struct {
+    sim_fix fixes[MAX_FIXES];
+    size_t count;
+    uint32_t frames; // every frame, velocity included
+    uint32_t bits;
+    uint32_t position_frames; // just those making up fixes
+    uint32_t position_bits;
+} pass;
+
+static pass canlib_pass, compact_pass;
+static gps_fix_rx_t rx;
+
+// Bits a standard frame takes on the bus, stuff bits included, up to the end of the
+// interframe space. Identifiers are as host_canlib.c makes them.
+static unsigned frame_bits(const can_msg_t *msg) {
+    uint8_t bits[128];
+    unsigned n = 0;
+
+    bits[n++] = 0; // SOF
+    for (int i = 10; i >= 0; i--) {
+        bits[n++] = (msg->sid >> i) & 1;
+    }
+    bits[n++] = 0; // RTR
+    bits[n++] = 0; // IDE
+    bits[n++] = 0; // r0
+    for (int i = 3; i >= 0; i--) {
+        bits[n++] = (msg->data_len >> i) & 1;
+    }
+    for (unsigned byte = 0; byte < msg->data_len; byte++) {
+        for (int i = 7; i >= 0; i--) {
+            bits[n++] = (msg->data[byte] >> i) & 1;
+        }
+    }
+
+    uint16_t crc = 0;
+    for (unsigned i = 0; i < n; i++) {
+        bool next = bits[i] ^ ((crc >> 14) & 1);
+        crc = (crc << 1) & 0x7fff;
+        if (next) {
+            crc ^= 0x4599;
+        }
+    }
+    for (int i = 14; i >= 0; i--) {
+        bits[n++] = (crc >> i) & 1;
+    }
+
+    // A stuff bit after every five the same, counting stuff bits themselves
+    unsigned stuffed = 0;
+    unsigned run = 0;
+    uint8_t last = 2;
+    for (unsigned i = 0; i < n; i++) {
+        if (bits[i] == last) {
+            run++;
+        } else {
+            last = bits[i];
+            run = 1;
+        }
+        if (run == 5) {
+            stuffed++;
+            last = !last;
+            run = 1;
+        }
+    }
+
+    // CRC delimiter, ACK slot and delimiter, EOF, interframe space
+    return n + stuffed + 1 + 2 + 7 + 3;
+}
+
+// 1e-4 minutes to 1e-7 degrees, rounded as gps_module.c does
+static int32_t canlib_coord(const uint8_t *data, char neg_dir) {
+    uint32_t dmin = (uint32_t)data[1] * 10000 + (((uint16_t)data[2] << 8) | data[3]);
+    int32_t value = (int32_t)(data[0] * 10000000UL + (dmin * 1000 + 30) / 60);
+    return data[4] == neg_dir ? -value : value;
+}
+
+static void add_fix(pass *p, const sim_fix *fix) {
+    if (p->count < MAX_FIXES) {
+        p->fixes[p->count++] = *fix;
+    }
+}
+
+static void handle_canlib_frame(const can_msg_t *msg) {
+    // Fixes start with their time and end with altitude
+    static sim_fix fix;
+    const uint8_t *data = msg->data + 2;
+    switch (get_message_type(msg)) {
+        case MSG_GPS_TIMESTAMP:
+            fix.second_of_day = data[0] * 3600UL + data[1] * 60U + data[2];
+            fix.csec = data[3];
+            break;
+        case MSG_GPS_LATITUDE:
+            fix.lat = canlib_coord(data, 'S');
+            break;
+        case MSG_GPS_LONGITUDE:
+            fix.lon = canlib_coord(data, 'W');
+            break;
+        case MSG_GPS_INFO:
+            fix.numsat = data[0];
+            fix.quality = data[1];
+            break;
+        case MSG_GPS_ALTITUDE:
+            fix.alt = (((uint16_t)data[0] << 8) | data[1]) * 10 + data[2] / 10;
+            add_fix(&canlib_pass, &fix);
+            break;
+        default:
+            return;
+    }
+    canlib_pass.position_frames++;
+    canlib_pass.position_bits += frame_bits(msg);
+}
+
+static void handle_compact_frame(const can_msg_t *msg) {
+    gps_fix_rx_fix_t rx_fix;
+    if (get_message_type(msg) != MSG_DEBUG_RAW || msg->data[2] < GPS_MSG_FIX_TIME
+        || msg->data[2] >= GPS_MSG_FIX_TIME + GPS_FIX_FRAMES) {
+        return;
+    }
+    compact_pass.position_frames++;
+    compact_pass.position_bits += frame_bits(msg);
+
+    if (gps_fix_rx_handle(&rx, msg, &rx_fix)) {
+        sim_fix fix = {
+            .lat = rx_fix.lat,
+            .lon = rx_fix.lon,
+            .alt = rx_fix.alt,
+            .numsat = rx_fix.numsat,
+            .quality = rx_fix.quality,
+        };
+        if (rx_fix.tow == GPS_TOW_UNKNOWN) {
+            fix.second_of_day = UINT32_MAX;
+        } else {
+            uint32_t gps_seconds = rx_fix.tow / 1000;
+            fix.second_of_day = (gps_seconds + 86400 - GPS_UTC_LEAP_SECONDS) % 86400;
+            fix.csec = rx_fix.tow % 1000 / 10;
+        }
+        add_fix(&compact_pass, &fix);
+    }
+}
+
+static void replay(pass *p, void (*handle)(const can_msg_t *), const uint8_t *log, size_t len) {
+    memset(p, 0, sizeof(*p));
+    host_can_reset();
+    for (size_t i = 0; i < len; i++) {
+        gps_handle_byte(log[i]);
+        assemble_can_msgs();
+        for (size_t j = 0; j < host_can_log_len; j++) {
+            p->frames++;
+            p->bits += frame_bits(&host_can_log[j]);
+            handle(&host_can_log[j]);
+        }
+        host_can_log_len = 0;
+    }
+}
+
+static bool same_fix(const sim_fix *canlib, const sim_fix *compact) {
+    // The canlib messages cut coordinates to 1e-4 minutes, about 17e-7 degrees
+    int32_t max_coord_error = 17;
+    int32_t lat_error = labs((long)compact->lat - canlib->lat);
+    int32_t lon_error = labs((long)compact->lon - canlib->lon);
+    bool time_ok = compact->second_of_day == UINT32_MAX
+                   || (compact->second_of_day == canlib->second_of_day
+                       && compact->csec == canlib->csec);
+    // The canlib message can't carry negative altitudes
+    bool alt_ok = compact->alt == canlib->alt || (compact->alt < 0 && canlib->alt == 0);
+    return time_ok && alt_ok && lat_error <= max_coord_error && lon_error <= max_coord_error
+           && compact->numsat == canlib->numsat && compact->quality == canlib->quality;
+}
+
+static bool run(const char *path) {
+    size_t len;
+    uint8_t *log = bench_load_file(path, &len);
+    size_t name_len = strlen(path);
+    bool ubx = name_len > 4 && strcmp(path + name_len - 4, ".ubx") == 0;
+    gps_set_protocol(ubx ? GPS_PROTOCOL_UBX : GPS_PROTOCOL_NMEA);
+
+    gps_set_encoding(GPS_ENCODING_CANLIB);
+    replay(&canlib_pass, handle_canlib_frame, log, len);
+    gps_set_encoding(GPS_ENCODING_COMPACT);
+    gps_fix_rx_init(&rx);
+    replay(&compact_pass, handle_compact_frame, log, len);
+    free(log);
+
+    size_t fixes = canlib_pass.count;
+    size_t mismatched = 0;
+    size_t no_tow = 0;
+    for (size_t i = 0; i < fixes && i < compact_pass.count; i++) {
+        mismatched += !same_fix(&canlib_pass.fixes[i], &compact_pass.fixes[i]);
+        no_tow += compact_pass.fixes[i].second_of_day == UINT32_MAX;
+    }
+    bool ok = fixes > 0 && compact_pass.count == fixes && mismatched == 0 && rx.dropped == 0
+              && compact_pass.frames < canlib_pass.frames;
+
+    printf("%s\n", path);
+    printf("  %zu fixes, %zu decoded, %zu differ, %zu without time of week, %u dropped\n", fixes,
+           compact_pass.count, mismatched, no_tow, rx.dropped);
+    const pass *passes[] = {&canlib_pass, &compact_pass};
+    const char *names[] = {"canlib", "compact"};
+    for (int i = 0; i < 2; i++) {
+        const pass *p = passes[i];
+        printf("  %-8s %3.1f frames %5.1f bits per fix, %5.1f with velocity, bus load at",
+               names[i], (double)p->position_frames / fixes, (double)p->position_bits / fixes,
+               (double)p->bits / fixes);
+        for (size_t r = 0; r < sizeof(rates_hz) / sizeof(rates_hz[0]); r++) {
+            printf(" %u Hz %.2f%%", rates_hz[r], 100.0 * p->bits / fixes * rates_hz[r] / BIT_RATE);
+        }
+        printf("\n");
+    }
+    printf("  compact takes %.0f%% of the bus time %s\n",
+           100.0 * compact_pass.bits / canlib_pass.bits, ok ? "ok" : "UNEXPECTED");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s log...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    host_clock_reset();
+    timebase_init();
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        ok &= run(argv[i]);
+    }
+    return ok ? 0 : 1;
+}
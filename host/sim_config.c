@@ -0,0 +1,495 @@
+// Runs the boot-time receiver configuration (gps_config.c) against a simulated u-blox receiver
+// and reports how each scenario ends up. Then breaks the receiver in various ways and checks that
+// gps_recovery.c gets it going again, with resets backing off while they don't help.
+//
+// usage: sim_config
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xc.h>
+
+#include "canlib.h"
+
+#include "gps_config.h"
+#include "gps_general.h"
+#include "gps_module.h"
+#include "gps_msgs.h"
+#include "gps_recovery.h"
+#include "timebase.h"
+#include "uart_rx.h"
+#include "ubx.h"
+
+#include "host_timer.h"
+#include "host_uart.h"
+
+#define SIM_LENGTH_ms 20000
+#define TXQ_SIZE 8192
+// From ~HWR going high to the receiver's first output
+#define RCV_BOOT_ms 500
+#define MAX_RESETS 16
+
+// NMEA sentences the receiver can output, indexed by their CFG-MSG id
+static const char *const nmea_sentences[] = {
+    [UBX_NMEA_GGA] = "GPGGA,171202.00,4728.3740,N,08132.4074,W,1,08,1.02,322.2,M,-34.2,M,,",
+    [UBX_NMEA_GLL] = "GPGLL,4728.3740,N,08132.4074,W,171202.00,A,A",
+    [UBX_NMEA_GSA] = "GPGSA,A,3,02,05,12,15,18,24,25,29,,,,,1.84,1.02,1.53",
+    [UBX_NMEA_GSV] = "GPGSV,3,1,11,02,61,318,44,05,34,091,41,12,22,227,38,15,10,164,31",
+    [UBX_NMEA_RMC] = "GPRMC,171202.00,A,4728.3740,N,08132.4074,W,0.00,213.70,170926,,,A",
+    [UBX_NMEA_VTG] = "GPVTG,213.70,T,,M,0.00,N,0.00,K,A",
+};
+#define NUM_NMEA (sizeof(nmea_sentences) / sizeof(nmea_sentences[0]))
+
+// The same without a fix
+static const char *const no_fix_sentences[] = {
+    [UBX_NMEA_GGA] = "GPGGA,171202.00,,,,,0,00,99.99,,,,,,",
+    [UBX_NMEA_GLL] = "GPGLL,,,,,171202.00,V,N",
+    [UBX_NMEA_GSA] = "GPGSA,A,1,,,,,,,,,,,,,99.99,99.99,99.99",
+    [UBX_NMEA_GSV] = "GPGSV,1,1,00",
+    [UBX_NMEA_RMC] = "GPRMC,171202.00,V,,,,,,,170926,,,N",
+    [UBX_NMEA_VTG] = "GPVTG,,,,,,,,,N",
+};
+
+// Ways the receiver can go wrong
+typedef enum {
+    FAULT_NONE = 0,
+    FAULT_HANG, // stops sending anything
+    FAULT_NOISE, // sends a steady stream of garbage
+} fault;
+
+static struct {
+    bool connected;
+    bool accepts_ubx; // false for a receiver that isn't a u-blox
+    uint32_t baud;
+    uint16_t meas_rate_ms;
+    uint16_t out_proto;
+    uint8_t nmea_rate[NUM_NMEA];
+    uint8_t nav_pvt_rate;
+
+    // What it comes back to after a reset
+    uint32_t saved_baud;
+    uint16_t saved_meas_rate_ms;
+    bool saved_configured_msgs;
+
+    fault fault;
+    uint32_t fault_ms; // from when
+    bool fault_survives_reset;
+    uint32_t fix_after_ms; // from power on or reset
+    uint32_t started_ms; // power on or the end of the last reset
+    bool in_reset;
+    uint32_t resets;
+
+    uint32_t next_epoch_ms;
+    double tx_credit; // bytes the line can carry so far
+    uint8_t txq[TXQ_SIZE];
+    size_t txq_head, txq_tail;
+
+    // UBX input framing
+    uint8_t rx[256];
+    size_t rx_len;
+} rcv;
+
+static void rcv_queue(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        size_t next = (rcv.txq_head + 1) % TXQ_SIZE;
+        if (next == rcv.txq_tail) {
+            return; // receiver drops output it has no line time for
+        }
+        rcv.txq[rcv.txq_head] = data[i];
+        rcv.txq_head = next;
+    }
+}
+
+static void rcv_queue_nmea(const char *body) {
+    uint8_t checksum = 0;
+    for (const char *c = body; *c; c++) {
+        checksum ^= *c;
+    }
+    char line[128];
+    int len = snprintf(line, sizeof(line), "$%s*%02X\r\n", body, checksum);
+    rcv_queue((const uint8_t *)line, len);
+}
+
+static void rcv_queue_ubx(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len) {
+    uint8_t frame[8 + 256] = {UBX_SYNC_1, UBX_SYNC_2, cls, id, len & 0xff, len >> 8};
+    memcpy(frame + 6, payload, len);
+    uint8_t a = 0, b = 0;
+    for (size_t i = 2; i < 6u + len; i++) {
+        a += frame[i];
+        b += a;
+    }
+    frame[6 + len] = a;
+    frame[7 + len] = b;
+    rcv_queue(frame, 8 + len);
+}
+
+static void rcv_epoch(uint32_t now) {
+    bool fix = now - rcv.started_ms >= rcv.fix_after_ms;
+    if (rcv.out_proto & 0x0002) {
+        const char *const *sentences = fix ? nmea_sentences : no_fix_sentences;
+        for (size_t i = 0; i < NUM_NMEA; i++) {
+            if (rcv.nmea_rate[i] && sentences[i]) {
+                rcv_queue_nmea(sentences[i]);
+            }
+        }
+    }
+    if ((rcv.out_proto & 0x0001) && rcv.nav_pvt_rate) {
+        uint8_t pvt[UBX_NAV_PVT_LEN] = {0};
+        if (fix) {
+            pvt[20] = 3; // 3D fix
+            pvt[21] = 0x01; // gnssFixOK
+            pvt[23] = 8;
+        }
+        rcv_queue_ubx(UBX_CLASS_NAV, UBX_NAV_PVT, pvt, sizeof(pvt));
+    }
+}
+
+// Back to its saved settings, as at power on
+static void rcv_start(uint32_t now) {
+    rcv.baud = rcv.saved_baud;
+    rcv.meas_rate_ms = rcv.saved_meas_rate_ms;
+    rcv.out_proto = 0x0002;
+    for (size_t i = 0; i < NUM_NMEA; i++) {
+        rcv.nmea_rate[i] = !rcv.saved_configured_msgs || i == UBX_NMEA_GGA || i == UBX_NMEA_RMC;
+    }
+    rcv.nav_pvt_rate = 0;
+    rcv.txq_head = rcv.txq_tail = 0;
+    rcv.tx_credit = 0;
+    rcv.rx_len = 0;
+    rcv.started_ms = now;
+}
+
+// Follows ~HWR. Returns whether the receiver is running.
+static bool rcv_reset_pin(uint32_t now) {
+    if (LATC2 == 0) {
+        if (!rcv.in_reset) {
+            rcv.in_reset = true;
+            rcv.resets++;
+        }
+        return false;
+    }
+    if (rcv.in_reset) {
+        rcv.in_reset = false;
+        rcv_start(now);
+        rcv.next_epoch_ms = now + RCV_BOOT_ms;
+        if (!rcv.fault_survives_reset) {
+            rcv.fault = FAULT_NONE;
+        }
+    }
+    return true;
+}
+
+static uint16_t le16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static void rcv_handle_ubx(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len) {
+    if (cls != UBX_CLASS_CFG) {
+        return;
+    }
+    if (id == UBX_CFG_PRT && len == 20 && payload[0] == 1) {
+        rcv.baud = le16(payload + 8) | ((uint32_t)le16(payload + 10) << 16);
+        rcv.out_proto = le16(payload + 14);
+    } else if (id == UBX_CFG_RATE && len == 6) {
+        rcv.meas_rate_ms = le16(payload);
+    } else if (id == UBX_CFG_MSG && len == 3) {
+        if (payload[0] == UBX_CLASS_NMEA && payload[1] < NUM_NMEA) {
+            rcv.nmea_rate[payload[1]] = payload[2];
+        } else if (payload[0] == UBX_CLASS_NAV && payload[1] == UBX_NAV_PVT) {
+            rcv.nav_pvt_rate = payload[2];
+        }
+    }
+}
+
+// Bytes from the firmware. They only make sense to the receiver if both ends agree on the baud.
+static void rcv_input(uint8_t byte) {
+    if (!rcv.connected || !rcv.accepts_ubx || host_uart_baud != rcv.baud) {
+        rcv.rx_len = 0;
+        return;
+    }
+
+    if (rcv.rx_len == 0 && byte != UBX_SYNC_1) {
+        return;
+    }
+    rcv.rx[rcv.rx_len++] = byte;
+    if (rcv.rx_len == 2 && byte != UBX_SYNC_2) {
+        rcv.rx_len = 0;
+        return;
+    }
+    if (rcv.rx_len >= 6) {
+        uint16_t len = le16(rcv.rx + 4);
+        if (len > sizeof(rcv.rx) - 8) {
+            rcv.rx_len = 0;
+        } else if (rcv.rx_len == 8u + len) {
+            uint8_t a = 0, b = 0;
+            for (size_t i = 2; i < 6u + len; i++) {
+                a += rcv.rx[i];
+                b += a;
+            }
+            if (a == rcv.rx[6 + len] && b == rcv.rx[7 + len]) {
+                rcv_handle_ubx(rcv.rx[2], rcv.rx[3], rcv.rx + 6, len);
+            }
+            rcv.rx_len = 0;
+        }
+    }
+}
+
+// Advances the receiver by 1 ms and moves what it sent in that time to the UART RX buffer
+static void rcv_tick(uint32_t now) {
+    bool running = rcv_reset_pin(now);
+    if (!rcv.connected || !running) {
+        return;
+    }
+    if (rcv.fault != FAULT_NONE && now >= rcv.fault_ms) {
+        if (rcv.fault == FAULT_NOISE) {
+            for (uint32_t i = 0; i < rcv.baud / 10000; i++) {
+                host_uart_receive((uint8_t)rand());
+            }
+        }
+        return;
+    }
+    if (now >= rcv.next_epoch_ms) {
+        rcv_epoch(now);
+        rcv.next_epoch_ms = now + rcv.meas_rate_ms;
+    }
+
+    // 10 bits per byte on the wire
+    rcv.tx_credit += rcv.baud / 10000.0;
+    while (rcv.tx_credit >= 1 && rcv.txq_tail != rcv.txq_head) {
+        uint8_t byte = rcv.txq[rcv.txq_tail];
+        rcv.txq_tail = (rcv.txq_tail + 1) % TXQ_SIZE;
+        rcv.tx_credit -= 1;
+        // At the wrong baud rate the firmware sees noise
+        host_uart_receive(host_uart_baud == rcv.baud ? byte : (uint8_t)rand());
+    }
+    if (rcv.txq_tail == rcv.txq_head) {
+        rcv.tx_credit = 0;
+    }
+}
+
+typedef struct {
+    const char *name;
+    bool connected;
+    bool accepts_ubx;
+    uint32_t baud;
+    uint16_t meas_rate_ms;
+    bool configured_msgs; // only GGA + RMC enabled already
+    gps_config_state expect;
+} scenario;
+
+static const scenario scenarios[] = {
+    {"cold receiver at 9600 baud", true, true, 9600, 1000, false, GPS_CONFIG_DONE},
+    {"warm reset, already at 115200", true, true, 115200, 100, true, GPS_CONFIG_DONE},
+    {"receiver left at 38400", true, true, 38400, 1000, false, GPS_CONFIG_DONE},
+    {"no receiver", false, true, 9600, 1000, false, GPS_CONFIG_FAILED},
+    {"receiver ignores UBX", true, false, 9600, 1000, false, GPS_CONFIG_FAILED},
+};
+
+static const char *const state_names[] = {
+    [GPS_CONFIG_DETECT] = "DETECT",
+    [GPS_CONFIG_SWITCH_BAUD] = "SWITCH_BAUD",
+    [GPS_CONFIG_SEND_NAV] = "SEND_NAV",
+    [GPS_CONFIG_VERIFY] = "VERIFY",
+    [GPS_CONFIG_DONE] = "DONE",
+    [GPS_CONFIG_FAILED] = "FAILED",
+};
+
+// Powers the board and the receiver on together
+static void power_on(const scenario *sc) {
+    memset(&rcv, 0, sizeof(rcv));
+    rcv.connected = sc->connected;
+    rcv.accepts_ubx = sc->accepts_ubx;
+    rcv.saved_baud = sc->baud;
+    rcv.saved_meas_rate_ms = sc->meas_rate_ms;
+    rcv.saved_configured_msgs = sc->configured_msgs;
+    rcv_start(0);
+    rcv.next_epoch_ms = rand() % rcv.meas_rate_ms;
+
+    host_clock_reset();
+    host_can_reset();
+    timebase_init();
+    uart_init();
+    gps_init();
+    host_uart_tx_hook = rcv_input;
+    gps_config_start();
+}
+
+static bool run(const scenario *sc) {
+    power_on(sc);
+
+    uint32_t finished_ms = 0;
+    uint16_t messages_at_finish = 0;
+    for (uint32_t now = 0; now < SIM_LENGTH_ms; now++) {
+        host_set_millis(now);
+        rcv_tick(now);
+        // main loop
+        const uint8_t *data;
+        uint16_t length;
+        while ((length = uart_rx_peek(&data)) != 0) {
+            gps_handle_bytes(data, length);
+            uart_rx_consume(length);
+        }
+        gps_config_heartbeat();
+
+        gps_config_state state = gps_config_get_state();
+        if (!finished_ms && (state == GPS_CONFIG_DONE || state == GPS_CONFIG_FAILED)) {
+            finished_ms = now;
+            messages_at_finish = gps_valid_messages();
+        }
+    }
+
+    gps_config_state state = gps_config_get_state();
+    double rate = 0;
+    if (finished_ms) {
+        rate = (uint16_t)(gps_valid_messages() - messages_at_finish) * 1000.0
+               / (SIM_LENGTH_ms - finished_ms);
+    }
+    bool ok = state == sc->expect;
+
+    printf("%-32s %-7s after %5u ms, uart %6u baud, receiver %6u baud %2u Hz, %5.1f msgs/s %s\n",
+           sc->name, state_names[state], finished_ms, gps_config_baud(), rcv.baud,
+           1000 / rcv.meas_rate_ms, rate, ok ? "ok" : "UNEXPECTED");
+    return ok;
+}
+
+typedef struct {
+    const char *name;
+    bool connected;
+    fault fault;
+    uint32_t fault_ms;
+    bool fault_survives_reset;
+    uint32_t fix_after_ms;
+    uint32_t length_ms;
+    uint32_t min_resets;
+    uint32_t max_resets;
+    gps_receiver_state expect;
+    uint16_t min_ttff; // 0.1 s, as last reported
+    uint16_t max_ttff;
+} recovery_scenario;
+
+// A cold receiver at its factory 9600 baud, 1 Hz, as on the first power up on the pad
+static const scenario cold = {"", true, true, 9600, 1000, false, GPS_CONFIG_DONE};
+
+static const recovery_scenario recovery_scenarios[] = {
+    {"healthy throughout", true, FAULT_NONE, 0, false, 1000, 60000, 0, 0, GPS_RECEIVER_HEALTHY,
+     10, 40},
+    {"fix after 90 s", true, FAULT_NONE, 0, false, 90000, 150000, 0, 0, GPS_RECEIVER_HEALTHY, 900,
+     905},
+    {"hangs at 30 s", true, FAULT_HANG, 30000, false, 1000, 60000, 1, 1, GPS_RECEIVER_HEALTHY, 10,
+     40},
+    {"noise from 30 s", true, FAULT_NOISE, 30000, false, 1000, 60000, 1, 1, GPS_RECEIVER_HEALTHY,
+     10, 40},
+    // The first reset 5 s after the last message, the next once a configuration has failed,
+    // which takes longer than the 10 s wait, then after 20, 40, 80 and 80 s
+    {"hangs for good at 30 s", true, FAULT_HANG, 30000, true, 1000, 330000, 6, 6,
+     GPS_RECEIVER_NO_DATA, 10, 40},
+    {"no receiver", false, FAULT_NONE, 0, false, 0, 300000, 6, 6, GPS_RECEIVER_NO_DATA, 0xffff,
+     0xffff},
+};
+
+static const char *const receiver_state_names[] = {
+    [GPS_RECEIVER_NO_DATA] = "NO_DATA",
+    [GPS_RECEIVER_NO_VALID_MESSAGES] = "NO_VALID",
+    [GPS_RECEIVER_NO_FIX] = "NO_FIX",
+    [GPS_RECEIVER_HEALTHY] = "HEALTHY",
+};
+
+static bool run_recovery(const recovery_scenario *sc) {
+    power_on(&cold);
+    rcv.connected = sc->connected;
+    rcv.fault = sc->fault;
+    rcv.fault_ms = sc->fault_ms;
+    rcv.fault_survives_reset = sc->fault_survives_reset;
+    rcv.fix_after_ms = sc->fix_after_ms;
+    gps_recovery_init();
+
+    // From the state messages
+    gps_receiver_state state = GPS_RECEIVER_NO_DATA;
+    uint16_t ttff = 0xffff;
+    uint32_t state_msgs = 0;
+    uint32_t reset_ms[MAX_RESETS];
+    uint32_t resets = 0;
+    bool was_in_reset = false;
+    uint32_t longest_reset_ms = 0;
+    uint32_t reset_start = 0;
+
+    for (uint32_t now = 0; now < sc->length_ms; now++) {
+        host_set_millis(now);
+        rcv_tick(now);
+        // main loop, with recovery at its place in main.c's task table
+        const uint8_t *data;
+        uint16_t length;
+        while ((length = uart_rx_peek(&data)) != 0) {
+            gps_handle_bytes(data, length);
+            uart_rx_consume(length);
+        }
+        gps_config_heartbeat();
+        if (now % 10 == 5) {
+            gps_recovery_heartbeat();
+        }
+
+        for (size_t i = 0; i < host_can_log_len; i++) {
+            const uint8_t *payload = host_can_log[i].data + 2;
+            if (get_message_type(&host_can_log[i]) == MSG_DEBUG_RAW
+                && payload[0] == GPS_MSG_RECEIVER_STATE) {
+                state = payload[1];
+                ttff = ((uint16_t)payload[4] << 8) | payload[5];
+                state_msgs++;
+            }
+        }
+        host_can_reset();
+
+        if (LATC2 == 0 && !was_in_reset) {
+            if (resets < MAX_RESETS) {
+                reset_ms[resets] = now;
+            }
+            resets++;
+            reset_start = now;
+        } else if (LATC2 == 1 && was_in_reset && now - reset_start > longest_reset_ms) {
+            longest_reset_ms = now - reset_start;
+        }
+        was_in_reset = LATC2 == 0;
+    }
+
+    // Each wait at least as long as the one before, at most twice as long as the configured
+    // maximum, and the pulse long enough to reset the receiver
+    bool backing_off = true;
+    for (uint32_t i = 2; i < resets && i < MAX_RESETS; i++) {
+        uint32_t wait = reset_ms[i] - reset_ms[i - 1];
+        uint32_t last_wait = reset_ms[i - 1] - reset_ms[i - 2];
+        backing_off &= wait + 20 >= last_wait
+                       && wait <= (GPS_RECOVERY_TIMEOUT_ms << GPS_RECOVERY_MAX_BACKOFF) + 1000;
+    }
+    bool ok = state == sc->expect && state == gps_recovery_state() && resets >= sc->min_resets
+              && resets <= sc->max_resets && resets == rcv.resets && backing_off
+              && ttff >= sc->min_ttff && ttff <= sc->max_ttff
+              && (resets == 0 || longest_reset_ms >= GPS_RESET_PULSE_ms);
+
+    printf("%-32s %-8s %2u state msgs, ttff ", sc->name, receiver_state_names[state], state_msgs);
+    if (ttff == 0xffff) {
+        printf("  none");
+    } else {
+        printf("%5.1f s", ttff / 10.0);
+    }
+    printf(", %u resets", resets);
+    for (uint32_t i = 0; i < resets && i < MAX_RESETS; i++) {
+        printf("%s %.1f", i ? "" : " at", reset_ms[i] / 1000.0);
+    }
+    printf("%s %s\n", resets ? " s" : "", ok ? "ok" : "UNEXPECTED");
+    return ok;
+}
+
+int main(void) {
+    srand(1);
+
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        ok &= run(&scenarios[i]);
+    }
+    for (size_t i = 0; i < sizeof(recovery_scenarios) / sizeof(recovery_scenarios[0]); i++) {
+        ok &= run_recovery(&recovery_scenarios[i]);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
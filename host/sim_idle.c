@@ -0,0 +1,244 @@
+// Replays recorded receiver logs as the receiver would send them at 1, 5 and 10 fixes a second,
+// through a main loop laid out like main.c's that idles the CPU with scheduler_idle() whenever it
+// has nothing to do, and estimates how much of the time the CPU is busy. Each log is cut into as
+// many equal bursts as it has fixes, one burst per epoch at the configured line rate.
+//
+// The host can't time the firmware as the board runs it, so each task moves the clock on by a
+// modelled cost, and interrupts cost what host_isr.c says. The idle fraction the status messages
+// report is checked against what the model spent.
+//
+// usage: sim_idle log...
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xc.h>
+
+#include "canlib.h"
+
+#include "can_tx.h"
+#include "gps_config.h"
+#include "gps_general.h"
+#include "gps_health.h"
+#include "gps_module.h"
+#include "gps_msgs.h"
+#include "pps.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "uart_rx.h"
+
+#include "bench.h"
+#include "host_isr.h"
+#include "host_timer.h"
+#include "host_uart.h"
+
+// Fosc/4
+#define CYCLES_PER_s 12e6
+// Start bit, 8 data bits and a stop bit
+#define BITS_PER_BYTE 10
+
+// Rough estimates of each task's cost, instruction cycles. Replace them with figures from a
+// board's GPS_MSG_TASK_STATS.
+#define PASS_CYCLES 40 // calling a task and timing it, whether or not it has anything to do
+#define PARSE_BYTE_CYCLES 120
+#define FRAME_CYCLES 600 // building and enqueueing a CAN frame
+#define STATUS_CYCLES 3000
+#define STATS_CYCLES 1500
+
+static const unsigned rates_hz[] = {1, 5, 10};
+
+static const uint8_t *log_data;
+static size_t log_len;
+static bool log_ubx;
+static size_t next_byte;
+static size_t burst_len;
+static double epoch_ns;
+static double byte_ns;
+
+static double busy_ns;
+static uint32_t sleeps;
+static uint32_t status_reports;
+static uint32_t idle_permille_total;
+
+// The next byte from the receiver, and when the one after it comes
+static void receive(void) {
+    host_uart_receive(log_data[next_byte++]);
+    if (next_byte == log_len) {
+        host_external_ns = INFINITY;
+    } else if (next_byte % burst_len == 0) {
+        host_external_ns = next_byte / burst_len * epoch_ns;
+    } else {
+        host_external_ns += byte_ns;
+    }
+}
+
+static void spend(uint32_t cycles) {
+    double ns = cycles * 1e9 / CYCLES_PER_s;
+    busy_ns += ns;
+    host_clock_run(host_clock_now_ns() + ns);
+}
+
+static void handle_uart_bytes(void) {
+    const uint8_t *data;
+    uint16_t length;
+    uint32_t bytes = 0;
+    while ((length = uart_rx_peek(&data)) != 0) {
+        gps_handle_bytes(data, length);
+        uart_rx_consume(length);
+        bytes += length;
+    }
+    spend(PASS_CYCLES + bytes * PARSE_BYTE_CYCLES);
+}
+
+static void publish(void) {
+    uint32_t frames = host_can_enqueued;
+    assemble_can_msgs();
+    spend(PASS_CYCLES + (host_can_enqueued - frames) * FRAME_CYCLES);
+}
+
+static void heartbeat(void) {
+    timebase_heartbeat();
+    spend(PASS_CYCLES);
+}
+
+static void transmit(void) {
+    can_tx_heartbeat();
+    spend(PASS_CYCLES);
+}
+
+// gps_config, time_sync, error_checks and the bus check, which the host doesn't build or which
+// have nothing to do here
+static void other(void) {
+    spend(4 * PASS_CYCLES);
+}
+
+static void status(void) {
+    uint16_t idle = scheduler_idle_permille();
+    can_msg_t msg;
+    build_gps_board_telemetry_msg(PRIO_LOW, millis(), GPS_TELEMETRY_IDLE, idle, &msg);
+    can_tx_enqueue(&msg);
+    gps_health_publish();
+    spend(STATUS_CYCLES);
+
+    status_reports++;
+    idle_permille_total += idle;
+}
+
+static void stats(void) {
+    scheduler_publish_stats();
+    spend(STATS_CYCLES);
+}
+
+static const scheduler_task_t tasks[] = {
+    {handle_uart_bytes, 0, 0, 5},
+    {publish, 0, 0, 1},
+    {heartbeat, 0, 0, 1},
+    {other, 0, 0, 5},
+    {status, 500, 500, 10},
+    {stats, 1000, 250, 10},
+    {transmit, 0, 0, 1},
+};
+#define TASKS (sizeof(tasks) / sizeof(tasks[0]))
+
+// Fixes a log makes, which is how many epochs it's cut into
+static uint32_t count_fixes(void) {
+    host_can_reset();
+    for (size_t i = 0; i < log_len; i++) {
+        gps_handle_byte(log_data[i]);
+        assemble_can_msgs();
+    }
+    return host_can_count(MSG_GPS_TIMESTAMP);
+}
+
+static bool run(unsigned rate_hz, uint32_t fixes) {
+    host_pps_enabled = true;
+    host_pps_offset_ns = 0.5e9;
+    host_clock_reset();
+    host_can_reset();
+    timebase_init();
+    pps_init();
+    uart_init();
+    gps_init();
+    gps_set_protocol(log_ubx ? GPS_PROTOCOL_UBX : GPS_PROTOCOL_NMEA);
+    can_tx_init();
+    host_uart_baud = GPS_CONFIG_BAUD;
+    host_isr_cycles = 0;
+
+    epoch_ns = 1e9 / rate_hz;
+    byte_ns = BITS_PER_BYTE * 1e9 / host_uart_baud;
+    burst_len = log_len / fixes;
+    next_byte = 0;
+    host_external_ns = 0;
+    host_external_event = receive;
+
+    busy_ns = 0;
+    sleeps = 0;
+    status_reports = 0;
+    idle_permille_total = 0;
+
+    // Whole seconds, past the bytes left over after the last whole burst
+    double end_ns = ceil((fixes + 1) * epoch_ns / 1e9) * 1e9;
+    scheduler_init(tasks, TASKS);
+    while (host_clock_now_ns() < end_ns) {
+        scheduler_run();
+
+        bool gie = INTCON0bits.GIE;
+        INTCON0bits.GIE = 0;
+        const uint8_t *data;
+        if (uart_rx_peek(&data) == 0) {
+            scheduler_idle();
+            sleeps++;
+        }
+        INTCON0bits.GIE = gie;
+    }
+    host_external_event = NULL;
+
+    double seconds = host_clock_now_ns() / 1e9;
+    double isr_ns = host_isr_cycles * 1e9 / CYCLES_PER_s;
+    double busy = (busy_ns + isr_ns) / host_clock_now_ns();
+    double reported_idle = idle_permille_total / 1000.0 / status_reports;
+    uint32_t published = host_can_count(MSG_GPS_TIMESTAMP);
+    bool burst_fits = burst_len * byte_ns < epoch_ns;
+
+    // Interrupts wake the CPU from idle and are counted in it, so what's reported is over by
+    // their share of the time
+    bool ok = burst_fits && published == fixes && uart_rx_dropped() == 0
+              && fabs(1 - reported_idle - busy + isr_ns / host_clock_now_ns()) < 0.005;
+
+    printf("  %2u Hz %5.0f bytes/s: busy %5.2f%% (interrupts %4.2f%%), reported idle %5.1f%%, "
+           "%6.0f wakes/s, %u/%u fixes %s\n",
+           rate_hz, log_len / seconds, 100 * busy, 100 * isr_ns / host_clock_now_ns(),
+           100 * reported_idle, sleeps / seconds, published, fixes, ok ? "ok" : "UNEXPECTED");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s log...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        uint8_t *log = bench_load_file(argv[i], &log_len);
+        log_data = log;
+        size_t name_len = strlen(argv[i]);
+        log_ubx = name_len > 4 && strcmp(argv[i] + name_len - 4, ".ubx") == 0;
+
+        host_clock_reset();
+        timebase_init();
+        gps_init();
+        gps_set_protocol(log_ubx ? GPS_PROTOCOL_UBX : GPS_PROTOCOL_NMEA);
+        uint32_t fixes = count_fixes();
+        printf("%s: %u fixes, %zu bytes each at %u baud\n", argv[i], fixes, log_len / fixes,
+               GPS_CONFIG_BAUD);
+        for (size_t r = 0; r < sizeof(rates_hz) / sizeof(rates_hz[0]); r++) {
+            ok &= run(rates_hz[r], fixes);
+        }
+        free(log);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+// Runs the scheduler in scheduler.c over a table of modelled tasks, each taking a set time, and
+// checks that periodic tasks keep their period and phase, that run times and overruns are counted
+// as they happened, and that the stats go out over CAN as they stand.
+//
+// usage: sim_scheduler
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "canlib.h"
+
+#include "gps_msgs.h"
+#include "scheduler.h"
+#include "timebase.h"
+
+#include "host_timer.h"
+
+#define SIM_LENGTH_ms 10000
+
+// What each modelled task takes, and what it saw
+typedef struct {
+    const char *name;
+    uint32_t cost_us;
+    uint32_t first_ms; // of its first run, UINT32_MAX until then
+    uint32_t last_ms;
+    uint32_t max_gap_ms; // between runs
+    uint32_t runs;
+} model;
+
+enum { POLL, FAST, SLOW, HICCUP, STATS, MODELS };
+
+static model models[MODELS] = {
+    [POLL] = {"poll", 150},
+    [FAST] = {"fast", 800},
+    [SLOW] = {"slow", 2000},
+    [HICCUP] = {"hiccup", 300},
+    [STATS] = {"stats", 0},
+};
+
+static void take(model *m, uint32_t cost_us) {
+    uint32_t now = millis();
+    if (m->runs == 0) {
+        m->first_ms = now;
+    } else if (now - m->last_ms > m->max_gap_ms) {
+        m->max_gap_ms = now - m->last_ms;
+    }
+    m->last_ms = now;
+    m->runs++;
+    host_clock_run(host_clock_now_ns() + cost_us * 1e3);
+}
+
+static void poll(void) {
+    take(&models[POLL], models[POLL].cost_us);
+}
+
+static void fast(void) {
+    take(&models[FAST], models[FAST].cost_us);
+}
+
+static void slow(void) {
+    take(&models[SLOW], models[SLOW].cost_us);
+}
+
+// Every tenth run takes 30 ms, past its own deadline and holding up whatever comes due meanwhile
+static void hiccup(void) {
+    model *m = &models[HICCUP];
+    take(m, m->runs % 10 == 9 ? 30000 : m->cost_us);
+}
+
+static void stats(void) {
+    take(&models[STATS], 0);
+    scheduler_publish_stats();
+}
+
+static const scheduler_task_t tasks[] = {
+    [POLL] = {poll, 0, 0, 1},
+    [FAST] = {fast, 20, 5, 3},
+    [SLOW] = {slow, 100, 50, 5},
+    [HICCUP] = {hiccup, 250, 130, 10},
+    [STATS] = {stats, 1000, 500, 0},
+};
+
+// Overruns each task should count: the hiccup's own, and the fast task's runs it holds up past
+// their deadline, 27 ms of the 30 at most
+static bool check_overruns(const scheduler_stats_t *s) {
+    uint32_t hiccups = models[HICCUP].runs / 10;
+    return s[POLL].overruns == 0 && s[SLOW].overruns <= hiccups && s[HICCUP].overruns == hiccups
+           && s[FAST].overruns >= hiccups && s[FAST].overruns <= hiccups * 2
+           && s[STATS].overruns == 0;
+}
+
+// Decodes the stats messages sent at the end of the run against the stats as they stand
+static bool check_messages(void) {
+    scheduler_stats_t decoded[MODELS] = {0};
+    bool seen[MODELS] = {false};
+
+    host_can_log_len = 0;
+    for (int i = 0; i < MODELS; i++) {
+        scheduler_publish_stats();
+    }
+    for (size_t i = 0; i < host_can_log_len; i++) {
+        const uint8_t *data = host_can_log[i].data + 2;
+        if (get_message_type(&host_can_log[i]) != MSG_DEBUG_RAW || data[0] != GPS_MSG_TASK_STATS) {
+            continue;
+        }
+        uint8_t task = data[1] >> 4;
+        uint32_t value = ((uint32_t)data[2] << 24) | ((uint32_t)data[3] << 16)
+                         | ((uint32_t)data[4] << 8) | data[5];
+        if (task >= MODELS) {
+            return false;
+        }
+        seen[task] = true;
+        switch (data[1] & 0x0f) {
+            case GPS_TASK_STATS_RUNS:
+                decoded[task].runs = value;
+                break;
+            case GPS_TASK_STATS_BUSY_US:
+                decoded[task].busy_us = value;
+                break;
+            case GPS_TASK_STATS_MAX_US:
+                decoded[task].max_us = value;
+                break;
+            case GPS_TASK_STATS_OVERRUNS:
+                decoded[task].overruns = value;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    for (int i = 0; i < MODELS; i++) {
+        scheduler_stats_t s;
+        scheduler_get_stats(i, &s);
+        if (!seen[i] || decoded[i].runs != s.runs || decoded[i].busy_us != s.busy_us
+            || decoded[i].max_us != s.max_us || decoded[i].overruns != s.overruns) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(void) {
+    host_clock_reset();
+    timebase_init();
+    for (int i = 0; i < MODELS; i++) {
+        models[i].first_ms = UINT32_MAX;
+    }
+
+    scheduler_init(tasks, MODELS);
+    while (millis() < SIM_LENGTH_ms) {
+        scheduler_run();
+    }
+
+    scheduler_stats_t s[MODELS];
+    uint32_t busy_us = 0;
+    bool ok = true;
+    printf("%-8s %6s %6s %6s %8s %8s %7s %9s\n", "task", "period", "phase", "first", "max gap",
+           "runs", "max us", "overruns");
+    for (int i = 0; i < MODELS; i++) {
+        scheduler_get_stats(i, &s[i]);
+        busy_us += s[i].busy_us;
+        const model *m = &models[i];
+        printf("%-8s %6u %6u %6u %8u %8u %7u %9u\n", m->name, tasks[i].period_ms,
+               tasks[i].phase_ms, m->first_ms, m->max_gap_ms, s[i].runs, s[i].max_us,
+               s[i].overruns);
+
+        ok &= s[i].runs == m->runs;
+        if (tasks[i].period_ms == 0) {
+            continue;
+        }
+        // The first run on time, and every one after within a period of the last save for those
+        // held up by a hiccup. Each hiccup can cost a run of anything it holds up for a whole
+        // period, but no others are missed.
+        uint32_t expected = (SIM_LENGTH_ms - tasks[i].phase_ms) / tasks[i].period_ms + 1;
+        uint32_t hiccups = models[HICCUP].runs / 10;
+        ok &= m->first_ms == tasks[i].phase_ms;
+        ok &= m->max_gap_ms <= tasks[i].period_ms + 30U;
+        ok &= m->runs + hiccups + 1 >= expected && m->runs <= expected;
+    }
+    ok &= check_overruns(s);
+    // Time spent outside the tasks is only the scheduler's, which the model doesn't charge for
+    uint32_t total_us = millis() * 1000;
+    ok &= busy_us <= total_us && busy_us + 1000 >= total_us;
+    bool messages_ok = check_messages();
+    ok &= messages_ok;
+
+    printf("%.1f%% of the time in tasks, stats messages %s %s\n", 100.0 * busy_us / total_us,
+           messages_ok ? "match" : "differ", ok ? "ok" : "UNEXPECTED");
+    return ok ? 0 : 1;
+}
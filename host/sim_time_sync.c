@@ -0,0 +1,249 @@
+// Runs the time sync in time_sync.c over a modelled CAN bus to a board running the reference
+// receiver in reference/time_sync_rx.c, and checks the UTC that board ends up with against
+// true UTC.
+//
+// usage: sim_time_sync
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "canlib.h"
+
+#include "can_tx.h"
+#include "gps_module.h"
+#include "gps_msgs.h"
+#include "pps.h"
+#include "time_sync.h"
+#include "timebase.h"
+
+#include "host_timer.h"
+#include "reference/time_sync_rx.h"
+
+#define SIM_LENGTH_s 300
+// Error is judged over the end of the run, well after the GPS board has locked
+#define SETTLED_s 60
+// How often the GPS board's main loop runs
+#define LOOP_ns 50e3
+// How often the receiving board's idea of UTC is checked
+#define SAMPLE_ns 1e6
+// A 10 Hz receiver's last epoch of the second, whose fix only comes in after the next edge
+#define LATE_EPOCH_ms 900
+
+// Modelled bus
+#define BIT_RATE 125000
+#define BIT_ns (1e9 / BIT_RATE)
+// A standard frame with 8 data bytes, before stuffing and without the interframe space
+#define FRAME_BITS 108
+#define MAX_STUFF_BITS 24
+#define INTERFRAME_BITS 3
+
+// The GPS board's oscillator, locked to PPS well before the end of the run
+#define GPS_OSC_ERROR_ppm 8000
+
+typedef struct {
+    const char *name;
+    double rx_osc_error_ppm; // the receiving board's clock
+    int burst_frames; // enqueued by the GPS board just ahead of each PPS edge
+    double busy_probability; // another board's frame is on the bus when ours is ready
+    uint32_t start_second_of_day; // UTC at power on
+    uint32_t max_error_us;
+} scenario;
+
+static const scenario scenarios[] = {
+    {"quiet bus", 0, 0, 0, 43200, 150},
+    {"receiver 2% fast", 20000, 0, 0, 43200, 150},
+    {"receiver 1.5% slow", -15000, 0, 0, 43200, 150},
+    {"10 frames queued ahead", 0, 10, 0, 43200, 150},
+    // Arbitration lost to a frame already on the bus can't be seen by either end
+    {"busy bus", 0, 0, 0.5, 43200, 1300},
+    {"across midnight", 20000, 0, 0, 86400 - 200, 150},
+};
+
+static const scenario *sc;
+static time_sync_rx_t rx;
+static double rx_offset_us;
+
+// Frame on the bus, or waiting for it
+static struct {
+    bool in_flight;
+    double done_ns;
+    double free_ns; // end of the interframe space after the last frame
+} bus;
+
+static uint32_t max_after_edge_us;
+
+static uint32_t rx_local_us(double t_ns) {
+    double us = t_ns * (1 + sc->rx_osc_error_ppm * 1e-6) / 1e3 + rx_offset_us;
+    return (uint32_t)(uint64_t)floor(us);
+}
+
+static double true_utc_us(double t_ns) {
+    double utc = sc->start_second_of_day * 1e6 + (t_ns - host_pps_offset_ns) / 1e3;
+    return fmod(utc, TIME_SYNC_RX_US_PER_DAY);
+}
+
+static void bus_deliver(double t_ns) {
+    if (!bus.in_flight || bus.done_ns > t_ns) {
+        return;
+    }
+    bus.in_flight = false;
+    host_can_tx_complete();
+
+    const can_msg_t *msg = &host_can_txb;
+    if (get_message_type(msg) == MSG_DEBUG_RAW && msg->data[2] == GPS_MSG_TIME_FOLLOW_UP) {
+        uint32_t after_edge = ((uint32_t)msg->data[4] << 24) | ((uint32_t)msg->data[5] << 16)
+                              | ((uint32_t)msg->data[6] << 8) | msg->data[7];
+        if (after_edge > max_after_edge_us) {
+            max_after_edge_us = after_edge;
+        }
+    }
+    time_sync_rx_handle(&rx, msg, rx_local_us(bus.done_ns));
+}
+
+static void bus_start(double t_ns) {
+    if (!host_can_txb_full || bus.in_flight) {
+        return;
+    }
+    double start_ns = t_ns > bus.free_ns ? t_ns : bus.free_ns;
+    if ((double)rand() / RAND_MAX < sc->busy_probability) {
+        // Part way through another board's frame, which ours then waits out
+        start_ns += (double)rand() / RAND_MAX * (FRAME_BITS + MAX_STUFF_BITS + INTERFRAME_BITS)
+                    * BIT_ns;
+    }
+    int bits = FRAME_BITS + rand() % (MAX_STUFF_BITS + 1);
+    bus.done_ns = start_ns + bits * BIT_ns;
+    bus.free_ns = bus.done_ns + INTERFRAME_BITS * BIT_ns;
+    bus.in_flight = true;
+}
+
+// What the receiver would report for the second starting at an edge
+static void publish_fix(uint32_t second) {
+    uint32_t second_of_day = (sc->start_second_of_day + second) % 86400;
+    gps_fix_t fix = {0};
+    fix.hour = second_of_day / 3600;
+    fix.min = second_of_day / 60 % 60;
+    fix.sec = second_of_day % 60;
+    fix.quality = 1;
+    gps_commit_position(&fix, pps_epoch_time(0));
+    assemble_can_msgs();
+}
+
+static void burst(void) {
+    for (int i = 0; i < sc->burst_frames; i++) {
+        can_msg_t msg;
+        build_general_board_status_msg(PRIO_LOW, millis(), 0, 0, &msg);
+        can_tx_enqueue(&msg);
+    }
+}
+
+static bool run(void) {
+    host_osc_error_ppm = GPS_OSC_ERROR_ppm;
+    host_pps_enabled = true;
+    host_pps_offset_ns = (double)rand() / RAND_MAX * 1e9;
+    host_pps_jitter_ns = 0;
+    host_clock_reset();
+    host_can_reset();
+    timebase_init();
+    pps_init();
+    time_sync_init();
+    txb_init(NULL, 0, time_sync_can_send, can_send_rdy);
+    can_tx_init();
+
+    time_sync_rx_init(&rx, BIT_RATE);
+    rx_offset_us = (double)rand() / RAND_MAX * 4e9;
+    bus.in_flight = false;
+    bus.free_ns = 0;
+    max_after_edge_us = 0;
+
+    // The main loop doesn't run in step with the edges
+    double loop_phase_ns = (double)rand() / RAND_MAX * LOOP_ns;
+
+    double max_error_us = 0;
+    bool synced = true;
+    double next_sample_ns = 0;
+    // millis() at the last late epoch, and how many late fixes weren't stamped with it
+    bool late_epoch_seen = false;
+    uint32_t late_epoch_ms = 0;
+    uint32_t late_misses = 0;
+
+    for (uint32_t second = 0; second < SIM_LENGTH_s; second++) {
+        double edge_ns = second * 1e9 + host_pps_offset_ns;
+        bool fix_sent = false;
+        bool burst_sent = false;
+        bool late_checked = false;
+        bool late_marked = false;
+
+        for (double t = edge_ns + loop_phase_ns; t < edge_ns + 1e9; t += LOOP_ns) {
+            // Fix messages come in a while after the edge, the burst just before the next one
+            if (!fix_sent && t >= edge_ns + 90e6) {
+                publish_fix(second);
+                fix_sent = true;
+            }
+            if (!burst_sent && t >= edge_ns + 999e6) {
+                burst();
+                burst_sent = true;
+            }
+
+            host_clock_run(t);
+            if (!late_checked && t >= edge_ns + 90e6) {
+                // The late epoch of the second before is stamped from the edge before this one
+                if (late_epoch_seen && second >= SIM_LENGTH_s - SETTLED_s) {
+                    int32_t late_error = (int32_t)(pps_epoch_time(LATE_EPOCH_ms) - late_epoch_ms);
+                    if (late_error < -1 || late_error > 1) {
+                        late_misses++;
+                    }
+                }
+                late_checked = true;
+            }
+            if (!late_marked && t >= edge_ns + LATE_EPOCH_ms * 1e6) {
+                late_epoch_ms = millis();
+                late_epoch_seen = true;
+                late_marked = true;
+            }
+            bus_deliver(t);
+            timebase_heartbeat();
+            time_sync_heartbeat();
+            can_tx_heartbeat();
+            bus_start(t);
+
+            if (second >= SIM_LENGTH_s - SETTLED_s && t >= next_sample_ns) {
+                next_sample_ns = t + SAMPLE_ns;
+
+                uint64_t utc_us;
+                if (!time_sync_rx_utc(&rx, rx_local_us(t), &utc_us)) {
+                    synced = false;
+                    continue;
+                }
+                double error = utc_us - true_utc_us(t);
+                if (error > TIME_SYNC_RX_US_PER_DAY / 2) {
+                    error -= TIME_SYNC_RX_US_PER_DAY;
+                } else if (error < -(double)TIME_SYNC_RX_US_PER_DAY / 2) {
+                    error += TIME_SYNC_RX_US_PER_DAY;
+                }
+                if (fabs(error) > max_error_us) {
+                    max_error_us = fabs(error);
+                }
+            }
+        }
+    }
+
+    bool ok = synced && max_error_us <= sc->max_error_us && late_misses == 0;
+    printf("%-24s sync held up to %6u us, receiver UTC within %5.0f us, %u late epochs missed%s "
+           "%s\n",
+           sc->name, max_after_edge_us, max_error_us, late_misses, synced ? "" : ", no sync",
+           ok ? "ok" : "UNEXPECTED");
+    return ok;
+}
+
+int main(void) {
+    srand(1);
+
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        sc = &scenarios[i];
+        ok &= run();
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+// Runs the PPS disciplining in timebase.c against a modelled oscillator with different error
+// profiles, and checks how well the local clock follows PPS.
+//
+// usage: sim_timebase
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pps.h"
+#include "timebase.h"
+
+#include "host_timer.h"
+
+#define SIM_LENGTH_s 300
+// Steady state is judged over the end of the run
+#define SETTLED_s 60
+// How often the main loop runs
+#define LOOP_ns 1e6
+
+typedef struct {
+    const char *name;
+    double (*osc_error_ppm)(double t_s);
+    double jitter_ns;
+    double dropout_start_s; // PPS off between these, 0 for never
+    double dropout_end_s;
+    uint32_t max_phase_us; // steady state
+    int32_t max_freq_error_ppb;
+} scenario;
+
+static double nominal(double t_s) {
+    return 0;
+}
+
+static double fast(double t_s) {
+    return 8000;
+}
+
+static double slow(double t_s) {
+    return -15000;
+}
+
+// Warming up after power on, 1 ppm/s
+static double ramp(double t_s) {
+    return 3000 - t_s;
+}
+
+// Thermal cycling, 100 ppm either way over a ten minute period
+static double cycling(double t_s) {
+    return -4000 + 100 * sin(2 * M_PI * t_s / 600);
+}
+
+static const scenario scenarios[] = {
+    {"nominal oscillator", nominal, 0, 0, 0, 2, 500},
+    {"oscillator 0.8% fast", fast, 0, 0, 0, 2, 500},
+    {"oscillator 1.5% slow", slow, 0, 0, 0, 2, 500},
+    // The frequency window lags a drifting oscillator by about half its length, and the phase
+    // loop holds the clock off by enough to make up the difference
+    {"warming up, 1 ppm/s", ramp, 0, 0, 0, 25, 6000},
+    {"thermal cycling", cycling, 0, 0, 0, 25, 6000},
+    {"1 us PPS jitter", fast, 1000, 0, 0, 4, 1000},
+    {"PPS lost for 30 s", ramp, 0, 150, 180, 25, 6000},
+};
+
+static bool run(const scenario *sc) {
+    host_clock_reset();
+    host_osc_error_ppm = sc->osc_error_ppm(0);
+    host_pps_enabled = true;
+    // The receiver's seconds start anywhere relative to power on
+    host_pps_offset_ns = (double)rand() / RAND_MAX * 1e9;
+    host_pps_jitter_ns = sc->jitter_ns;
+    timebase_init();
+    pps_init();
+
+    double lock_s = -1;
+    uint32_t settled_phase_us = 0;
+    uint32_t dropout_phase_us = 0;
+    int32_t settled_freq_error_ppb = 0;
+    bool monotonic = true;
+    uint32_t last_us = 0;
+
+    for (int second = 0; second < SIM_LENGTH_s; second++) {
+        // Main loop through the second
+        double start_ns = second * 1e9 + host_pps_offset_ns;
+        for (double t = start_ns; t < start_ns + 1e9; t += LOOP_ns) {
+            host_osc_error_ppm = sc->osc_error_ppm(t / 1e9);
+            host_pps_enabled = !(t >= sc->dropout_start_s * 1e9 && t < sc->dropout_end_s * 1e9);
+            host_clock_run(t);
+
+            uint32_t now_us = micros();
+            if ((int32_t)(now_us - last_us) < 0) {
+                monotonic = false;
+            }
+            last_us = now_us;
+
+            timebase_heartbeat();
+        }
+
+        // Where the local clock is at the top of the true second
+        host_clock_run((second + 1) * 1e9 + host_pps_offset_ns);
+        int32_t phase_us = micros() % 1000000;
+        if (phase_us > 500000) {
+            phase_us -= 1000000;
+        }
+        uint32_t abs_phase_us = abs(phase_us);
+
+        bool in_dropout = second + 1 >= sc->dropout_start_s && second + 1 < sc->dropout_end_s + 5;
+        if (!timebase_locked() && !in_dropout) {
+            lock_s = -1;
+        } else if (lock_s < 0 && timebase_locked()) {
+            lock_s = second + 1;
+        }
+        if (in_dropout && abs_phase_us > dropout_phase_us) {
+            dropout_phase_us = abs_phase_us;
+        }
+        if (second >= SIM_LENGTH_s - SETTLED_s) {
+            if (abs_phase_us > settled_phase_us) {
+                settled_phase_us = abs_phase_us;
+            }
+            int32_t freq_error =
+                timebase_osc_error_ppb() - (int32_t)(host_osc_error_ppm * 1000);
+            if (abs(freq_error) > abs(settled_freq_error_ppb)) {
+                settled_freq_error_ppb = freq_error;
+            }
+        }
+    }
+
+    bool ok = monotonic && lock_s >= 0 && settled_phase_us <= sc->max_phase_us
+              && abs(settled_freq_error_ppb) <= sc->max_freq_error_ppb;
+
+    printf("%-22s locked after %4.0f s, phase %3u us, frequency %+6d ppb",
+           sc->name, lock_s, settled_phase_us, settled_freq_error_ppb);
+    if (sc->dropout_start_s) {
+        printf(", %u us in holdover", dropout_phase_us);
+    }
+    printf("%s %s\n", monotonic ? "" : ", went backwards", ok ? "ok" : "UNEXPECTED");
+    return ok;
+}
+
+int main(void) {
+    srand(1);
+
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        ok &= run(&scenarios[i]);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,141 @@
+#include <string.h>
+
+#include <xc.h>
+
+#include "canlib.h"
+
+#include "can_tx.h"
+#include "gps_msgs.h"
+#include "isr_profile.h"
+#include "timebase.h"
+
+#if ISR_PROFILE
+
+// Bucket pairs after the count and min/max
+#define PARTS_PER_BRANCH (GPS_ISR_PROFILE_BUCKETS + ISR_PROFILE_BUCKETS / 2)
+
+volatile uint16_t isr_profile_entry = 0;
+volatile uint16_t isr_profile_branch_start = 0;
+
+// Written by the interrupt handler
+static isr_profile_stats_t stats[ISR_PROFILE_BRANCHES];
+
+static volatile bool dump_requested = false;
+static volatile bool reset_requested = false;
+
+// Dump in progress, main loop only
+static struct {
+    bool active;
+    uint8_t branch;
+    isr_profile_stats_t taken[ISR_PROFILE_BRANCHES];
+} dump;
+
+static void clear_stats(void) {
+    memset(stats, 0, sizeof(stats));
+    for (uint8_t i = 0; i < ISR_PROFILE_BRANCHES; i++) {
+        stats[i].min = UINT16_MAX;
+    }
+}
+
+void isr_profile_init(void) {
+    clear_stats();
+    dump.active = false;
+    dump_requested = false;
+    reset_requested = false;
+
+    // Timer3 free running from Fosc/4, one count per instruction cycle. It wraps every 5.5 ms,
+    // far longer than the handler should ever take.
+    T3CLK = 0b00001;
+    T3CONbits.CKPS = 0b00;
+    T3CONbits.RD16 = 1;
+    TMR3 = 0;
+    T3CONbits.ON = 1;
+}
+
+void isr_profile_record(isr_profile_branch branch, uint16_t cycles) {
+    isr_profile_stats_t *s = &stats[branch];
+    s->count++;
+    if (cycles < s->min) {
+        s->min = cycles;
+    }
+    if (cycles > s->max) {
+        s->max = cycles;
+    }
+
+    uint8_t bucket = 0;
+    uint16_t limit = ISR_PROFILE_BUCKET_0_CYCLES;
+    while (bucket < ISR_PROFILE_BUCKETS - 1 && cycles >= limit) {
+        bucket++;
+        limit <<= 1;
+    }
+    if (s->buckets[bucket] != UINT16_MAX) {
+        s->buckets[bucket]++;
+    }
+}
+
+void isr_profile_get(isr_profile_branch branch, isr_profile_stats_t *out) {
+    bool gie = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    *out = stats[branch];
+    INTCON0bits.GIE = gie;
+}
+
+void isr_profile_reset(void) {
+    bool gie = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    clear_stats();
+    INTCON0bits.GIE = gie;
+}
+
+void isr_profile_request_dump(bool reset) {
+    reset_requested = reset;
+    dump_requested = true;
+}
+
+static uint32_t part_value(const isr_profile_stats_t *s, uint8_t part) {
+    if (part == GPS_ISR_PROFILE_COUNT) {
+        return s->count;
+    }
+    if (part == GPS_ISR_PROFILE_MIN_MAX) {
+        // No runs yet reads as a min of 0
+        uint16_t min = s->count ? s->min : 0;
+        return ((uint32_t)min << 16) | s->max;
+    }
+    uint8_t bucket = (part - GPS_ISR_PROFILE_BUCKETS) * 2;
+    return ((uint32_t)s->buckets[bucket] << 16) | s->buckets[bucket + 1];
+}
+
+void isr_profile_heartbeat(void) {
+    // A request during a dump starts it over, so what's sent is all from one moment
+    if (dump_requested) {
+        dump_requested = false;
+
+        // Taken and cleared together so no run is lost between the two
+        bool gie = INTCON0bits.GIE;
+        INTCON0bits.GIE = 0;
+        memcpy(dump.taken, stats, sizeof(stats));
+        if (reset_requested) {
+            clear_stats();
+        }
+        INTCON0bits.GIE = gie;
+
+        dump.branch = 0;
+        dump.active = true;
+    }
+    if (!dump.active) {
+        return;
+    }
+
+    const isr_profile_stats_t *s = &dump.taken[dump.branch];
+    for (uint8_t part = 0; part < PARTS_PER_BRANCH; part++) {
+        can_msg_t msg;
+        build_gps_isr_profile_msg(PRIO_LOW, millis(), dump.branch, part, part_value(s, part), &msg);
+        can_tx_enqueue(&msg);
+    }
+
+    if (++dump.branch == ISR_PROFILE_BRANCHES) {
+        dump.active = false;
+    }
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef ISR_PROFILE_H
+#define ISR_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Instrumentation build that times each branch of main.c's interrupt handler, and the handler
+// as a whole, against Timer3 counting instruction cycles. Define as 1 to build it in; otherwise
+// the hooks compile to nothing and Timer3 is left alone.
+#ifndef ISR_PROFILE
+#define ISR_PROFILE 0
+#endif
+
+typedef enum {
+    ISR_PROFILE_CAN = 0,
+    ISR_PROFILE_UART_ERROR,
+    ISR_PROFILE_UART_RX, // DMA1 half full, or one byte with the per-byte receive interrupt
+    ISR_PROFILE_TIMEBASE, // CCP2, the millisecond tick
+    ISR_PROFILE_PPS, // CCP1
+    ISR_PROFILE_CAN_TX, // TXB0 empty, or CCP3 at the end of the gap after it
+    ISR_PROFILE_ADC, // ADCC threshold, at the end of each burst of the telemetry sequence
+    ISR_PROFILE_TOTAL, // entry to exit, whichever branches ran, less the context save and restore
+    ISR_PROFILE_BRANCHES,
+} isr_profile_branch;
+
+// Bucket 0 counts runs under 64 cycles, each bucket after that up to twice as long as the one
+// before, and the last everything from 4096 cycles (341 us) on
+#define ISR_PROFILE_BUCKETS 8
+#define ISR_PROFILE_BUCKET_0_CYCLES 64
+
+// Instruction cycles, Fosc/4, each run took
+typedef struct {
+    uint32_t count;
+    uint16_t min;
+    uint16_t max;
+    uint16_t buckets[ISR_PROFILE_BUCKETS]; // stop counting when full
+} isr_profile_stats_t;
+
+#if ISR_PROFILE
+
+// Start of the handler and of the current branch, for the hooks below
+extern volatile uint16_t isr_profile_entry;
+extern volatile uint16_t isr_profile_branch_start;
+
+// Wrapped around the handler and each of its branches
+#define ISR_PROFILE_ENTER() (isr_profile_entry = TMR3)
+#define ISR_PROFILE_BEGIN() (isr_profile_branch_start = TMR3)
+#define ISR_PROFILE_END(branch) isr_profile_record(branch, TMR3 - isr_profile_branch_start)
+#define ISR_PROFILE_EXIT() isr_profile_record(ISR_PROFILE_TOTAL, TMR3 - isr_profile_entry)
+
+// Starts Timer3 free running at Fosc/4 and clears the stats
+void isr_profile_init(void);
+
+void isr_profile_record(isr_profile_branch branch, uint16_t cycles);
+
+void isr_profile_get(isr_profile_branch branch, isr_profile_stats_t *stats);
+
+void isr_profile_reset(void);
+
+// Asks for the stats to be sent over CAN, as requested by a GPS_MSG_ISR_PROFILE_REQUEST. Safe to
+// call from the interrupt handler. reset: clear them once they've been taken.
+void isr_profile_request_dump(bool reset);
+
+// Sends a requested dump as GPS_MSG_ISR_PROFILE messages, one branch per call so as not to fill
+// the transmit pool. Called from the main loop.
+void isr_profile_heartbeat(void);
+
+#else
+
+#define ISR_PROFILE_ENTER()
+#define ISR_PROFILE_BEGIN()
+#define ISR_PROFILE_END(branch)
+#define ISR_PROFILE_EXIT()
+
+#endif
+
+#endif /* ISR_PROFILE_H */
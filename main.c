@@ -3,24 +3,60 @@
 #include <xc.h>
 
 #include "canlib.h"
-#include "timer.h"
 
 #include "mcc_generated_files/adcc.h"
 #include "mcc_generated_files/fvr.h"
 
+#include "can_tx.h"
 #include "config.h"
 #include "error_checks.h"
+#include "gps_config.h"
 #include "gps_general.h"
+#include "gps_health.h"
 #include "gps_module.h"
+#include "gps_msgs.h"
+#include "gps_recovery.h"
+#include "isr_profile.h"
+#include "pps.h"
+#include "scheduler.h"
+#include "time_sync.h"
+#include "timebase.h"
+#include "uart_rx.h"
 
 // Memory pool for CAN transmit buffer
 uint8_t tx_pool[500];
 static void can_msg_handler(const can_msg_t *msg);
 
-static void send_status_ok(void);
+static void handle_uart_bytes(void);
+static void check_bus_alive(void);
+static void send_status(void);
 
-static volatile bool recieved_first_message = false;
+static bool recieved_first_message = false;
 static volatile bool seen_can_message = false;
+static uint32_t last_message_millis = 0;
+
+// Everything the main loop does, in the order it's done. A task's place here is the number its
+// GPS_MSG_TASK_STATS messages carry.
+static const scheduler_task_t tasks[] = {
+    // run, period_ms, phase_ms, deadline_ms
+    {handle_uart_bytes, 0, 0, 5},
+    {assemble_can_msgs, 0, 0, 1},
+    // One UBX message per pass, CFG-PRT at 9600 baud being the longest
+    {gps_config_heartbeat, 0, 0, 30},
+    {timebase_heartbeat, 0, 0, 1},
+    {time_sync_heartbeat, 0, 0, 1},
+    {error_checks_heartbeat, 0, 0, 2},
+    {check_bus_alive, 0, 0, 1},
+    // Periodic work is staggered so no two come due on the same pass
+    {send_status, MAX_LOOP_TIME_DIFF_ms, MAX_LOOP_TIME_DIFF_ms, 10},
+    {scheduler_publish_stats, 1000, 250, 10},
+    {gps_recovery_heartbeat, 10, 5, 1},
+#if ISR_PROFILE
+    {isr_profile_heartbeat, 0, 0, 2},
+#endif
+    // Last, so whatever the others queued goes out on the same pass
+    {can_tx_heartbeat, 0, 0, 1},
+};
 
 int main(void) {
     // Set frequency to be 48 MHZ
@@ -28,6 +64,7 @@ int main(void) {
 
     ADCC_Initialize();
     FVR_Initialize();
+    error_checks_init();
 
     // Enable global interrupts
     INTCON0bits.GIE = 1;
@@ -35,7 +72,12 @@ int main(void) {
     uart_init();
     led_init();
     gps_init();
-    timer0_init();
+    timebase_init();
+    pps_init();
+    time_sync_init();
+#if ISR_PROFILE
+    isr_profile_init();
+#endif
 
     // Set up CAN TX
     TRISC0 = 0;
@@ -50,108 +92,168 @@ int main(void) {
     can_timing_t can_setup;
     can_generate_timing_params(_XTAL_FREQ, &can_setup);
     can_init(&can_setup, can_msg_handler);
-    txb_init(tx_pool, sizeof(tx_pool), can_send, can_send_rdy);
+    txb_init(tx_pool, sizeof(tx_pool), time_sync_can_send, can_send_rdy);
+    can_tx_init();
 
-    uint32_t last_millis = millis();
-    uint32_t last_message_millis = millis();
+    // Find the receiver's baud rate and switch it to the rate and messages we want
+    gps_config_start();
+    gps_recovery_init();
 
     // Turn LED 1 on
     LED_1_ON();
 
-    // Wait for the first message
-    while (!recieved_first_message) {
+    scheduler_init(tasks, sizeof(tasks) / sizeof(tasks[0]));
+    last_message_millis = millis();
+
+    while (1) {
         CLRWDT(); // feed the watchdog, which is set for 256ms
 
-        if (seen_can_message) {
-            seen_can_message = false;
-            last_message_millis = millis();
-        }
+        scheduler_run();
 
-        if (millis() - last_message_millis > MAX_BUS_DEAD_TIME_ms) {
-            // We've got too long without seeing a valid CAN message (including one of ours)
-            RESET();
+        bool gie = INTCON0bits.GIE;
+        INTCON0bits.GIE = 0;
+        const uint8_t *data;
+        if (uart_rx_peek(&data) == 0) {
+            scheduler_idle();
         }
+        INTCON0bits.GIE = gie;
+    }
 
-        if (millis() - last_millis > 5000) {
-            // Haven't received anything, try resetting the gps
-            LATC2 = 0;
-            __delay_ms(100);
-            LATC2 = 1;
-            __delay_ms(100);
+    return (EXIT_SUCCESS);
+}
 
-            can_msg_t board_stat_msg;
-            build_general_board_status_msg(PRIO_LOW, millis(), 0, 1, &board_stat_msg);
-            txb_enqueue(&board_stat_msg);
+static void check_bus_alive(void) {
+    if (seen_can_message) {
+        seen_can_message = false;
+        last_message_millis = millis();
+    }
 
-            last_millis = millis();
-        }
+    if (millis() - last_message_millis > MAX_BUS_DEAD_TIME_ms) {
+        // We've got too long without seeing a valid CAN message (including one of ours)
+        RESET();
     }
+}
 
-    while (1) {
-        CLRWDT(); // feed the watchdog, which is set for 256ms
+static void send_status(void) {
+    if (!recieved_first_message) {
+        return;
+    }
 
-        if (seen_can_message) {
-            seen_can_message = false;
-            last_message_millis = millis();
-        }
+    uint32_t general_error_bitfield = 0;
+    if (check_5v_current_error()) {
+        general_error_bitfield |= (1 << E_5V_OVER_CURRENT_OFFSET);
+    }
 
-        if (millis() - last_message_millis > MAX_BUS_DEAD_TIME_ms) {
-            // We've got too long without seeing a valid CAN message (including one of ours)
-            RESET();
-        }
+    can_msg_t board_stat_msg;
+    build_general_board_status_msg(PRIO_LOW, millis(), general_error_bitfield, 0, &board_stat_msg);
+    can_tx_enqueue(&board_stat_msg);
 
-        if (millis() - last_millis > MAX_LOOP_TIME_DIFF_ms) {
-            uint32_t general_error_bitfield = 0;
-            if (check_5v_current_error()) {
-                general_error_bitfield |= (1 << E_5V_OVER_CURRENT_OFFSET);
-            }
+    can_msg_t clock_msg;
+    build_gps_clock_msg(
+        PRIO_LOW, millis(), timebase_locked(), timebase_osc_error_ppb(), &clock_msg
+    );
+    can_tx_post(CAN_TX_SLOT_GPS_CLOCK, &clock_msg);
 
-            can_msg_t board_stat_msg;
-            build_general_board_status_msg(
-                PRIO_LOW, millis(), general_error_bitfield, 0, &board_stat_msg
-            );
-            txb_enqueue(&board_stat_msg);
+    can_msg_t idle_msg;
+    build_gps_board_telemetry_msg(
+        PRIO_LOW, millis(), GPS_TELEMETRY_IDLE, scheduler_idle_permille(), &idle_msg
+    );
+    can_tx_enqueue(&idle_msg);
 
-            led_1_heartbeat();
-            last_millis = millis();
-        }
-        for (int i = 0; i < 1000; i++) {} // FIXME workaround to prevent sending message to fast
-        txb_heartbeat();
-    }
+    gps_health_publish();
 
-    return (EXIT_SUCCESS);
+    led_1_heartbeat();
+}
+
+// Feed everything received so far to the parser
+static void handle_uart_bytes(void) {
+    const uint8_t *data;
+    uint16_t length;
+    while ((length = uart_rx_peek(&data)) != 0) {
+        recieved_first_message = true;
+        gps_handle_bytes(data, length);
+        uart_rx_consume(length);
+    }
 }
 
 static void __interrupt() interrupt_handler() {
+    ISR_PROFILE_ENTER();
+
+    // TXB0 has sent its frame, ahead of canlib which would otherwise see the flag in PIR5
+    if (PIE5bits.TXB0IE == 1 && PIR5bits.TXB0IF == 1) {
+        ISR_PROFILE_BEGIN();
+        can_tx_handle_tx_interrupt();
+        PIR5bits.TXB0IF = 0;
+        ISR_PROFILE_END(ISR_PROFILE_CAN_TX);
+    }
+
     if (PIR5) {
         // Handle CAN
+        ISR_PROFILE_BEGIN();
         can_handle_interrupt();
+        ISR_PROFILE_END(ISR_PROFILE_CAN);
+    }
+
+    // UART receive error, before the byte it's about is read
+    if (PIE3bits.U1EIE == 1 && PIR3bits.U1EIF == 1) {
+        ISR_PROFILE_BEGIN();
+        uart_rx_handle_error_interrupt();
+        ISR_PROFILE_END(ISR_PROFILE_UART_ERROR);
     }
 
+#if UART_RX_DMA
+    // DMA1 has filled half the UART receive buffer
+    if (PIE2bits.DMA1SCNTIE == 1 && PIR2bits.DMA1SCNTIF == 1) {
+        ISR_PROFILE_BEGIN();
+        uart_rx_handle_interrupt();
+        PIR2bits.DMA1SCNTIF = 0;
+        ISR_PROFILE_END(ISR_PROFILE_UART_RX);
+    }
+#else
     // UART message
     if (PIR3bits.U1RXIF == 1) {
-        recieved_first_message = true;
-
-        if (U1ERRIRbits.FERIF) {
-            // UART frame error
-        }
+        ISR_PROFILE_BEGIN();
+        // Parsing happens in the main loop, keep the ISR short
+        uart_rx_push(U1RXB);
 
-        if (U1ERRIRbits.RXFOIF) {
-            // UART overflowed
-            U1ERRIRbits.RXFOIF = 0;
-        }
+        PIR3bits.U1RXIF = 0;
+        ISR_PROFILE_END(ISR_PROFILE_UART_RX);
+    }
+#endif
+
+    // CCP2 has matched Timer1 - the next millisecond has started
+    if (PIE4bits.CCP2IE == 1 && PIR4bits.CCP2IF == 1) {
+        ISR_PROFILE_BEGIN();
+        timebase_handle_interrupt();
+        PIR4bits.CCP2IF = 0;
+        ISR_PROFILE_END(ISR_PROFILE_TIMEBASE);
+    }
 
-        gps_handle_byte(U1RXB);
+    // CCP1 has captured a PPS edge. After CCP2 so that the millisecond is up to date.
+    if (PIE4bits.CCP1IE == 1 && PIR4bits.CCP1IF == 1) {
+        ISR_PROFILE_BEGIN();
+        pps_handle_interrupt();
+        PIR4bits.CCP1IF = 0;
+        ISR_PROFILE_END(ISR_PROFILE_PPS);
+    }
 
-        PIR3bits.U1RXIF = 0;
+    // CCP3 has matched Timer1 - the gap after the last frame is up
+    if (PIE4bits.CCP3IE == 1 && PIR4bits.CCP3IF == 1) {
+        ISR_PROFILE_BEGIN();
+        can_tx_handle_gap_interrupt();
+        PIR4bits.CCP3IF = 0;
+        ISR_PROFILE_END(ISR_PROFILE_CAN_TX);
     }
 
-    // Timer0 has overflowed - update millis() function
-    // This happens approximately every 500us
-    if (PIE3bits.TMR0IE == 1 && PIR3bits.TMR0IF == 1) {
-        timer0_handle_interrupt();
-        PIR3bits.TMR0IF = 0;
+    // The ADCC has finished a burst of telemetry samples
+    if (PIE1bits.ADTIE == 1 && PIR1bits.ADTIF == 1) {
+        ISR_PROFILE_BEGIN();
+        error_checks_handle_adc_interrupt();
+        PIR1bits.ADTIF = 0;
+        ISR_PROFILE_END(ISR_PROFILE_ADC);
     }
+
+    ISR_PROFILE_EXIT();
 }
 
 // This is called from within can_handle_interrupt()
@@ -178,6 +280,16 @@ static void can_msg_handler(const can_msg_t *msg) {
             }
             break;
 
+#if ISR_PROFILE
+        case MSG_DEBUG_RAW:
+            // Other boards give debug frames their own meanings, so the request names its board
+            if (msg->data[2] == GPS_MSG_ISR_PROFILE_REQUEST && msg->data[3] == BOARD_TYPE_UNIQUE_ID
+                && msg->data[4] == BOARD_INST_UNIQUE_ID) {
+                isr_profile_request_dump(msg->data[5] != 0);
+            }
+            break;
+#endif
+
         default:
             // all the other ones - do nothing
             break;
@@ -0,0 +1,124 @@
+#include "nmea_convert.h"
+
+// nmea_number_t.phase is PHASE_WHOLE while reading digits before the decimal point, then
+// PHASE_FRACTION plus the number of fractional digits read so far, up to NMEA_COORD_DIGITS.
+// PHASE_STOPPED is set on top once the number has ended, so the count is still there.
+#define PHASE_WHOLE 0
+#define PHASE_FRACTION 1
+#define PHASE_STOPPED 0x80
+
+// Integer digits in nmea_number_t.low
+#define LOW_DIGITS 4
+#define HIGH_LIMIT 100 // high holds the NMEA_INT_DIGITS - LOW_DIGITS digits before them
+
+// x / 60 for x below 600, as (x * 547) >> 15
+#define DIV60_MUL 547UL
+#define DIV60_SHIFT 15
+
+bool nmea_number_push(nmea_number_t *num, uint8_t byte) {
+    if (num->phase & PHASE_STOPPED) {
+        return true;
+    }
+
+    bool kept = true;
+    if ('0' <= byte && byte <= '9') {
+        uint8_t digit = byte - '0';
+        if (num->phase == PHASE_WHOLE) {
+            // The digit shifted out of the top of low moves on into high
+            uint16_t high = num->high * 10 + (num->low >> 12);
+            num->low = (num->low << 4) | digit;
+            if (num->int_count == NMEA_INT_DIGITS) {
+                // Longer than any field we decode, drop the most significant digit
+                while (high >= HIGH_LIMIT) {
+                    high -= HIGH_LIMIT;
+                }
+                kept = false;
+            } else {
+                num->int_count++;
+            }
+            num->high = (uint8_t)high;
+        } else if (num->phase < PHASE_FRACTION + NMEA_COORD_DIGITS) {
+            uint8_t place = num->phase - PHASE_FRACTION;
+            if (place < NMEA_FRAC_DIGITS) {
+                num->frac |= (uint16_t)digit << (4 * (NMEA_FRAC_DIGITS - 1 - place));
+            }
+            num->phase++;
+        }
+    } else if (byte == '.' && num->phase == PHASE_WHOLE) {
+        num->phase = PHASE_FRACTION;
+    } else {
+        num->phase |= PHASE_STOPPED;
+    }
+    return kept;
+}
+
+uint16_t nmea_number_int(const nmea_number_t *num, uint8_t skip, uint8_t count) {
+    uint8_t end = skip + count;
+    uint16_t value = end > LOW_DIGITS ? num->high : 0;
+    for (uint8_t pos = end < LOW_DIGITS ? end : LOW_DIGITS; pos > skip; pos--) {
+        value = value * 10 + ((num->low >> (4 * (pos - 1))) & 0xf);
+    }
+    return value;
+}
+
+uint16_t nmea_number_frac(const nmea_number_t *num, uint8_t count) {
+    uint16_t value = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        value *= 10;
+        if (i < NMEA_FRAC_DIGITS) {
+            value += (num->frac >> (4 * (NMEA_FRAC_DIGITS - 1 - i))) & 0xf;
+        }
+    }
+    return value;
+}
+
+bool nmea_number_equal(const nmea_number_t *a, const nmea_number_t *b) {
+    return a->low == b->low && a->frac == b->frac && a->high == b->high
+           && a->int_count == b->int_count && a->phase == b->phase;
+}
+
+// One step of long division by 60, bringing down the next digit
+static void div60_step(uint32_t *quot, uint8_t *rem, uint8_t digit) {
+    uint16_t x = *rem * 10 + digit;
+    uint8_t q = ((uint32_t)x * DIV60_MUL) >> DIV60_SHIFT;
+    *quot = *quot * 10 + q;
+    *rem = x - q * 60;
+}
+
+// Starts the division with the whole minutes, the last two integer digits
+static void div60_start(uint32_t *quot, uint8_t *rem, const nmea_number_t *num) {
+    *quot = 0;
+    *rem = 0;
+    div60_step(quot, rem, (num->low >> 4) & 0xf);
+    div60_step(quot, rem, num->low & 0xf);
+}
+
+bool nmea_coord_push(nmea_coord_t *coord, uint8_t byte) {
+    uint8_t phase = coord->num.phase;
+    bool kept = nmea_number_push(&coord->num, byte);
+    if (phase == PHASE_WHOLE && coord->num.phase == PHASE_FRACTION) {
+        div60_start(&coord->e7, &coord->rem, &coord->num);
+    } else if (phase >= PHASE_FRACTION && coord->num.phase == phase + 1) {
+        div60_step(&coord->e7, &coord->rem, byte - '0');
+    }
+    return kept;
+}
+
+uint32_t nmea_coord_e7(const nmea_coord_t *coord) {
+    uint32_t quot = coord->e7;
+    uint8_t rem = coord->rem;
+    uint8_t phase = coord->num.phase & ~PHASE_STOPPED;
+    uint8_t digits = 0;
+    if (phase == PHASE_WHOLE) {
+        // No decimal point
+        div60_start(&quot, &rem, &coord->num);
+    } else {
+        digits = phase - PHASE_FRACTION;
+    }
+
+    // The digits the receiver didn't send are zeros
+    for (; digits < NMEA_COORD_DIGITS; digits++) {
+        div60_step(&quot, &rem, 0);
+    }
+    return nmea_number_int(&coord->num, 2, 3) * 10000000UL + quot + (rem >= 30);
+}
@@ -0,0 +1,58 @@
+#ifndef NMEA_CONVERT_H
+#define NMEA_CONVERT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Integer digits kept per field: enough for hhmmss and dddmm. The last four are kept packed so
+// they can be split, the two before them as a binary value.
+#define NMEA_INT_DIGITS 6
+// Fractional digits kept per field, enough for the 1e-4 minutes the canlib messages carry
+#define NMEA_FRAC_DIGITS 4
+// Fractional digits of minutes a coordinate's 1e-7 degrees take in: down to about 0.2 mm
+#define NMEA_COORD_DIGITS 7
+
+// A decimal field decoded one byte at a time. The last four integer digits are shifted through a
+// packed BCD register as they arrive, so the sexagesimal parts (hh/mm/ss, deg/min) fall on nibble
+// boundaries and come out without dividing. A zeroed struct is an empty number.
+typedef struct {
+    uint16_t low; // last four integer digits, packed BCD, the last in the low nibble
+    uint16_t frac; // first NMEA_FRAC_DIGITS fractional digits, packed BCD, the first on top
+    uint8_t high; // the integer digits before the last four
+    uint8_t int_count; // integer digits read, up to NMEA_INT_DIGITS
+    uint8_t phase;
+} nmea_number_t;
+
+// A ddmm.mmmmmmm or dddmm.mmmmmmm coordinate, which also divides the minutes by 60 one digit at a
+// time as they arrive. A zeroed struct is an empty coordinate.
+typedef struct {
+    nmea_number_t num;
+    uint32_t e7; // minutes read so far / 60, in units of the last digit read
+    uint8_t rem; // and the remainder
+} nmea_coord_t;
+
+// Feeds the next byte of the field. Digits before the decimal point are shifted in (only the last
+// NMEA_INT_DIGITS are kept), the first NMEA_FRAC_DIGITS after it are kept, and any other byte
+// ends the number. Returns false if an integer digit had to be dropped.
+bool nmea_number_push(nmea_number_t *num, uint8_t byte);
+
+// Value of `count` integer digits, after skipping the `skip` least significant ones. e.g. for
+// hhmmss, nmea_number_int(num, 4, 2) gives the hours. Digits before the last four come as one
+// value, however many of them count reaches.
+uint16_t nmea_number_int(const nmea_number_t *num, uint8_t skip, uint8_t count);
+
+// Value of the first `count` fractional digits, up to NMEA_FRAC_DIGITS, e.g. 4 gives
+// ten-thousandths
+uint16_t nmea_number_frac(const nmea_number_t *num, uint8_t count);
+
+// Whether two numbers were read from the same digits
+bool nmea_number_equal(const nmea_number_t *a, const nmea_number_t *b);
+
+// nmea_number_push() for a coordinate
+bool nmea_coord_push(nmea_coord_t *coord, uint8_t byte);
+
+// The coordinate in 1e-7 degrees, rounded to nearest. Fractional digits past the
+// NMEA_COORD_DIGITS-th count as zero.
+uint32_t nmea_coord_e7(const nmea_coord_t *coord);
+
+#endif /* NMEA_CONVERT_H */
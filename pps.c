@@ -0,0 +1,66 @@
+#include <stdbool.h>
+
+#include <xc.h>
+
+#include "pps.h"
+#include "timebase.h"
+
+// Last PPS edge, written by the ISR. count changes with every edge so the main loop can tell if
+// an edge came in while it was reading the rest.
+static volatile struct {
+    bool seen;
+    uint8_t count;
+    timebase_stamp_t edge;
+} pps;
+
+void pps_init(void) {
+    // PPS input on RC4, already set as an input by gps_init()
+    ANSELC4 = 0;
+    CCP1PPS = 0b010100;
+
+    // CCP1 captures Timer1 on every rising edge
+    CCPTMRS0bits.C1TSEL = 0b01;
+    CCP1CONbits.MODE = 0b0101;
+    CCP1CONbits.EN = 1;
+
+    PIR4bits.CCP1IF = 0;
+    PIE4bits.CCP1IE = 1;
+}
+
+void pps_handle_interrupt(void) {
+    // The capture holds the time of the edge however long this interrupt waited behind others
+    timebase_stamp(CCPR1, (timebase_stamp_t *)&pps.edge);
+    pps.count++;
+    pps.seen = true;
+}
+
+uint8_t pps_last_edge(timebase_stamp_t *edge) {
+    uint8_t count;
+    do {
+        count = pps.count;
+        *edge = pps.edge;
+    } while (count != pps.count);
+    return count;
+}
+
+uint32_t pps_epoch_time(uint16_t ms_into_second) {
+    uint32_t now = millis();
+
+    timebase_stamp_t edge;
+    pps_last_edge(&edge);
+    if (!pps.seen) {
+        return now;
+    }
+
+    // The edge must be for this fix's second, so the epoch can't be in the future or long gone
+    uint32_t epoch_ms = edge.ms + (edge.us >= 500) + ms_into_second;
+    if ((int32_t)(now - epoch_ms) < 0) {
+        // A fix late in the second can finish after the next edge has come in. The timebase is
+        // disciplined to PPS, so that second started 1000 ms before the edge.
+        epoch_ms -= 1000;
+    }
+    if ((int32_t)(now - epoch_ms) < 0 || now - epoch_ms > PPS_MAX_FIX_LATENCY_ms) {
+        return now;
+    }
+    return epoch_ms;
+}
@@ -0,0 +1,29 @@
+#ifndef PPS_H
+#define PPS_H
+
+#include <stdint.h>
+
+#include "timebase.h"
+
+// A fix whose epoch, going by the last PPS edge, is further in the past than this when its
+// message completes is not matched to that edge. Covers the receiver's output latency plus the
+// time on the wire, with the receiver configured as in gps_config.h.
+#define PPS_MAX_FIX_LATENCY_ms 500
+
+// Starts the CCP1 capture of PPS edges on RC4. timebase_init() must have run.
+void pps_init(void);
+
+// Called from the interrupt handler when CCP1 has captured a PPS edge
+void pps_handle_interrupt(void);
+
+// Copies out the last PPS edge, and returns a count that changes with every edge. The edge is
+// only meaningful once the count has changed from 0.
+uint8_t pps_last_edge(timebase_stamp_t *edge);
+
+// millis() at the start of a fix's epoch, given how far into the UTC second the epoch is. Taken
+// from the last PPS edge, which marks the top of the second, so it doesn't depend on how long
+// the receiver took to send the fix, even if it finishes after the next edge. If there's no PPS
+// edge the fix could belong to, this is millis() now.
+uint32_t pps_epoch_time(uint16_t ms_into_second);
+
+#endif /* PPS_H */
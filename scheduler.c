@@ -0,0 +1,138 @@
+#include <xc.h>
+
+#include "canlib.h"
+
+#include "can_tx.h"
+#include "gps_msgs.h"
+#include "scheduler.h"
+#include "timebase.h"
+
+static const scheduler_task_t *table;
+static uint8_t task_count = 0;
+
+static uint32_t next_due[SCHEDULER_MAX_TASKS];
+static scheduler_stats_t stats[SCHEDULER_MAX_TASKS];
+static uint8_t next_report = 0;
+
+static uint32_t idle_us = 0;
+static uint32_t idle_window_start = 0; // micros()
+
+void scheduler_init(const scheduler_task_t *tasks, uint8_t count) {
+    table = tasks;
+    task_count = count < SCHEDULER_MAX_TASKS ? count : SCHEDULER_MAX_TASKS;
+    next_report = 0;
+    idle_us = 0;
+    idle_window_start = micros();
+
+    // SLEEP stops just the CPU, leaving the peripherals and their clocks running
+    CPUDOZEbits.IDLEN = 1;
+
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < task_count; i++) {
+        next_due[i] = now + table[i].phase_ms;
+        stats[i] = (scheduler_stats_t){0};
+    }
+}
+
+static void run_task(uint8_t i, uint32_t late_ms) {
+    const scheduler_task_t *task = &table[i];
+    uint32_t start = micros();
+    task->run();
+    uint32_t run_us = micros() - start;
+
+    scheduler_stats_t *s = &stats[i];
+    s->runs++;
+    s->busy_us += run_us;
+    if (run_us > s->max_us) {
+        s->max_us = run_us < UINT16_MAX ? run_us : UINT16_MAX;
+    }
+    if (task->deadline_ms != 0 && late_ms * 1000 + run_us > task->deadline_ms * 1000UL
+        && s->overruns != UINT16_MAX) {
+        s->overruns++;
+    }
+}
+
+void scheduler_run(void) {
+    for (uint8_t i = 0; i < task_count; i++) {
+        uint16_t period = table[i].period_ms;
+        if (period == 0) {
+            run_task(i, 0);
+            continue;
+        }
+
+        uint32_t now = millis();
+        int32_t late_ms = (int32_t)(now - next_due[i]);
+        if (late_ms < 0) {
+            continue;
+        }
+        // Keep to the original phase, unless whole periods have been missed
+        next_due[i] += period;
+        if ((int32_t)(now - next_due[i]) >= 0) {
+            next_due[i] = now + period;
+        }
+        run_task(i, late_ms);
+    }
+}
+
+void scheduler_idle(void) {
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < task_count; i++) {
+        if (table[i].period_ms != 0 && (int32_t)(now - next_due[i]) >= 0) {
+            return;
+        }
+    }
+
+    // Interrupts are off, so one that has come in since the caller looked is still pending and
+    // SLEEP falls straight through. The handler runs once the caller turns them back on.
+    uint32_t start = micros();
+    SLEEP();
+    idle_us += micros() - start;
+}
+
+uint16_t scheduler_idle_permille(void) {
+    uint32_t now = micros();
+    uint32_t window_ms = (now - idle_window_start) / 1000;
+    uint16_t permille = window_ms ? idle_us / window_ms : 0;
+    if (permille > 1000) {
+        permille = 1000;
+    }
+
+    idle_us = 0;
+    idle_window_start = now;
+    return permille;
+}
+
+void scheduler_get_stats(uint8_t task, scheduler_stats_t *out) {
+    *out = stats[task];
+}
+
+static uint32_t part_value(const scheduler_stats_t *s, uint8_t part) {
+    switch (part) {
+        case GPS_TASK_STATS_RUNS:
+            return s->runs;
+        case GPS_TASK_STATS_BUSY_US:
+            return s->busy_us;
+        case GPS_TASK_STATS_MAX_US:
+            return s->max_us;
+        default:
+            return s->overruns;
+    }
+}
+
+void scheduler_publish_stats(void) {
+    if (task_count == 0) {
+        return;
+    }
+
+    // Sends its own stats from before this run
+    const scheduler_stats_t *s = &stats[next_report];
+    for (uint8_t part = 0; part < GPS_TASK_STATS_PARTS; part++) {
+        can_msg_t msg;
+        build_gps_task_stats_msg(PRIO_LOW, millis(), next_report, part, part_value(s, part), &msg);
+        can_tx_enqueue(&msg);
+    }
+
+    if (++next_report == task_count) {
+        next_report = 0;
+    }
+}
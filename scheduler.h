@@ -0,0 +1,54 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Cooperative scheduler for the main loop. Tasks come from a static table and run in its order:
+// those with no period on every pass, the rest when they come due. Each run is timed with
+// micros() so every task's share of the CPU and its worst case can be reported over CAN.
+//
+// Between passes the CPU can idle until the next interrupt. The CCP2 millisecond interrupt wakes
+// it at least once a millisecond, which is as often as a periodic task can come due, and
+// everything else the tasks wait on (UART, DMA1, CAN, the ADC) raises its own interrupt.
+
+// Task stats messages carry the task's place in the table in a nibble
+#define SCHEDULER_MAX_TASKS 16
+
+typedef struct {
+    void (*run)(void);
+    uint16_t period_ms; // 0 to run on every pass of the loop
+    uint16_t phase_ms; // first due this long after scheduler_init(), to keep tasks apart
+    // An overrun if the run hasn't finished this long after the task was due, which for a task
+    // with no period is when it started. 0 for none.
+    uint16_t deadline_ms;
+} scheduler_task_t;
+
+typedef struct {
+    uint32_t runs;
+    uint32_t busy_us; // total run time, wraps around
+    uint16_t max_us; // longest run, saturating
+    uint16_t overruns;
+} scheduler_stats_t;
+
+// tasks must stay in place for as long as the scheduler runs
+void scheduler_init(const scheduler_task_t *tasks, uint8_t count);
+
+// One pass of the main loop
+void scheduler_run(void);
+
+// Idles the CPU until the next interrupt unless a periodic task is already due. Called once a pass
+// with interrupts off, after checking that nothing else is waiting to be done, so nothing an
+// interrupt brings in after the check waits for the next one.
+void scheduler_idle(void);
+
+// Time spent idle since the last call, 0.1%
+uint16_t scheduler_idle_permille(void);
+
+void scheduler_get_stats(uint8_t task, scheduler_stats_t *stats);
+
+// Sends one task's stats as GPS_MSG_TASK_STATS messages, going round the table in turn. Meant to
+// be a task itself.
+void scheduler_publish_stats(void);
+
+#endif /* SCHEDULER_H */
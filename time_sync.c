@@ -0,0 +1,127 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "canlib.h"
+
+#include "can_tx.h"
+#include "gps_msgs.h"
+#include "pps.h"
+#include "time_sync.h"
+#include "timebase.h"
+
+#define SECONDS_PER_DAY 86400UL
+
+// Last fix at the top of a second, main loop only
+static struct {
+    bool valid;
+    uint32_t second_of_day;
+    uint32_t epoch_ms;
+} fix_second;
+
+static struct {
+    uint8_t pps_count; // edge last considered for a sync
+    uint8_t seq;
+    uint32_t edge_us; // local time of the edge the outstanding sync is for
+    uint32_t enqueued_ms;
+    volatile bool awaiting_send;
+    // Written by time_sync_can_send(), which canlib may call from its interrupt
+    volatile bool sent;
+    volatile uint32_t sent_us;
+} sync;
+
+void time_sync_init(void) {
+    memset(&fix_second, 0, sizeof(fix_second));
+    memset((void *)&sync, 0, sizeof(sync));
+}
+
+void time_sync_handle_fix(const gps_fix_t *fix, uint32_t timestamp) {
+    if (fix->quality == 0 || fix->csec != 0) {
+        return;
+    }
+    fix_second.second_of_day = (uint32_t)fix->hour * 3600 + (uint16_t)fix->min * 60 + fix->sec;
+    fix_second.epoch_ms = timestamp;
+    fix_second.valid = true;
+}
+
+// UTC second that started at an edge, from the last fix at the top of a second. False if
+// that fix can't be tied to the edge.
+static bool edge_second_of_day(const timebase_stamp_t *edge, uint32_t *second_of_day) {
+    if (!fix_second.valid) {
+        return false;
+    }
+
+    // Rounded the same way as pps_epoch_time(), so the fix for this edge is exactly 0 ms before
+    uint32_t edge_ms = edge->ms + (edge->us >= 500);
+    uint32_t since_fix = edge_ms - fix_second.epoch_ms;
+    if (since_fix > TIME_SYNC_MAX_FIX_AGE_s * 1000UL + TIME_SYNC_MAX_EPOCH_ERROR_ms) {
+        return false;
+    }
+
+    uint16_t seconds = (since_fix + 500) / 1000;
+    int16_t error = (int16_t)(since_fix - seconds * 1000UL);
+    if (error > TIME_SYNC_MAX_EPOCH_ERROR_ms || error < -TIME_SYNC_MAX_EPOCH_ERROR_ms) {
+        return false;
+    }
+
+    *second_of_day = (fix_second.second_of_day + seconds) % SECONDS_PER_DAY;
+    return true;
+}
+
+static void send_follow_up(void) {
+    uint32_t after_edge = sync.sent_us - sync.edge_us;
+
+    can_msg_t msg;
+    build_gps_time_follow_up_msg(PRIO_LOW, millis(), sync.seq, after_edge, &msg);
+    can_tx_enqueue(&msg);
+}
+
+static void send_sync(void) {
+    timebase_stamp_t edge;
+    uint8_t count = pps_last_edge(&edge);
+    if (count == sync.pps_count) {
+        return;
+    }
+    sync.pps_count = count;
+
+    // Unlocked, microseconds after the edge aren't microseconds of UTC
+    uint32_t second_of_day;
+    if (!timebase_locked() || !edge_second_of_day(&edge, &second_of_day)) {
+        return;
+    }
+
+    sync.seq++;
+    sync.edge_us = edge.ms * 1000 + edge.us;
+    sync.sent = false;
+    sync.awaiting_send = true;
+    sync.enqueued_ms = millis();
+
+    // Highest priority so it loses as little arbitration as possible once it's in the hardware
+    can_msg_t msg;
+    build_gps_time_sync_msg(PRIO_HIGHEST, (uint16_t)edge.ms, sync.seq, second_of_day, &msg);
+    can_tx_enqueue(&msg);
+}
+
+void time_sync_heartbeat(void) {
+    if (sync.awaiting_send) {
+        if (sync.sent) {
+            sync.awaiting_send = false;
+            send_follow_up();
+        } else if (millis() - sync.enqueued_ms > TIME_SYNC_FOLLOW_UP_TIMEOUT_ms) {
+            sync.awaiting_send = false;
+        }
+        return;
+    }
+    send_sync();
+}
+
+void time_sync_can_send(const can_msg_t *msg) {
+    // Stamped as close to the hardware taking the frame as we can get
+    uint32_t now = micros();
+    can_send(msg);
+
+    if (sync.awaiting_send && !sync.sent && get_message_type(msg) == MSG_DEBUG_RAW
+        && msg->data[2] == GPS_MSG_TIME_SYNC && msg->data[3] == sync.seq) {
+        sync.sent_us = now;
+        sync.sent = true;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdint.h>
+
+#include "canlib.h"
+
+#include "gps_module.h"
+
+// Broadcasts UTC for the other boards on the bus to set their clocks by. Every PPS edge whose
+// UTC second is known gets two messages:
+//
+// - a sync, carrying the UTC second the edge started. Receivers note their own time when it
+//   arrives.
+// - a follow up with the same seq, sent once the sync has gone to the CAN hardware, carrying
+//   how long after the edge that was.
+//
+// The sync's UTC is then the edge's second plus the follow up's delay, however long the sync
+// waited in the transmit queue. What a receiver still has to allow for is the frame itself,
+// plus any arbitration lost to other traffic. host/reference/time_sync_rx.c does this and
+// serves as the reference for receivers on other boards.
+
+// A fix at the top of a second is only used to label edges this many seconds after it
+#define TIME_SYNC_MAX_FIX_AGE_s 5
+// How far the fix's epoch may be from a whole number of seconds before the edge, which is
+// only ever rounding while the timebase is locked
+#define TIME_SYNC_MAX_EPOCH_ERROR_ms 2
+// A sync not sent by now is left without a follow up, and receivers drop it
+#define TIME_SYNC_FOLLOW_UP_TIMEOUT_ms 500
+
+void time_sync_init(void);
+
+// Takes the UTC of a fix published with the given epoch timestamp, as from pps_epoch_time()
+void time_sync_handle_fix(const gps_fix_t *fix, uint32_t timestamp);
+
+// Sends the sync for a new PPS edge, and the follow up for a sync that's gone out. Called from
+// the main loop.
+void time_sync_heartbeat(void);
+
+// can_send() for txb_init(), which notes when a sync goes to the hardware
+void time_sync_can_send(const can_msg_t *msg);
+
+#endif /* TIME_SYNC_H */
@@ -0,0 +1,203 @@
+#include <string.h>
+
+#include <xc.h>
+
+#include "pps.h"
+#include "timebase.h"
+
+#define NOMINAL_STEP_Q16 ((uint32_t)TIMEBASE_TICKS_PER_ms << 16)
+// Change in the millisecond step for a 1 ppm change in rate, 1500 * 65536 / 1e6
+#define STEP_Q16_PER_ppm 98
+
+#define MAX_EDGE_ERROR (TIMEBASE_TICKS_PER_s / 1000 * TIMEBASE_MAX_OSC_ERROR_ppm / 1000)
+#define MIN_EDGE_INTERVAL (TIMEBASE_TICKS_PER_s - MAX_EDGE_ERROR)
+#define MAX_EDGE_INTERVAL (TIMEBASE_TICKS_PER_s + MAX_EDGE_ERROR)
+
+// Written by the CCP2 interrupt
+static volatile uint32_t ms_count = 0;
+static volatile uint32_t ms_start = 0; // Timer1 count, extended to 32 bits, where this ms began
+static uint32_t next_ms_start = 0;
+static uint16_t step_remainder = 0; // fraction of a tick carried into the next ms
+
+// Written by the main loop with interrupts off
+static volatile uint32_t step_q16 = NOMINAL_STEP_Q16; // Timer1 ticks per local ms
+static volatile uint16_t us_per_tick_q16 = 0;
+
+// Disciplining, main loop only
+static struct {
+    uint8_t pps_count; // last edge taken from pps.c
+    uint32_t last_edge_ms;
+    uint32_t edge_ticks[TIMEBASE_FREQ_WINDOW_s + 1]; // oldest first
+    uint8_t edges; // consecutive edges a second apart in edge_ticks
+    uint32_t freq_step_q16; // ticks per ms at the measured rate
+    int32_t osc_error_ppb;
+    bool slewing;
+    bool locked;
+} disc;
+
+static void set_step(uint32_t step) {
+    uint16_t us_per_tick = (1000UL << 20) / (step >> 12);
+
+    bool gie = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    step_q16 = step;
+    us_per_tick_q16 = us_per_tick;
+    INTCON0bits.GIE = gie;
+}
+
+void timebase_init(void) {
+    memset(&disc, 0, sizeof(disc));
+    disc.freq_step_q16 = NOMINAL_STEP_Q16;
+    set_step(NOMINAL_STEP_Q16);
+
+    ms_count = 0;
+    ms_start = 0;
+    next_ms_start = TIMEBASE_TICKS_PER_ms;
+    step_remainder = 0;
+
+    // Timer1 free running from Fosc/4 with a 1:8 prescaler, 1.5 MHz
+    T1CLK = 0b00001;
+    T1CONbits.CKPS = 0b11;
+    T1CONbits.RD16 = 1;
+    TMR1 = 0;
+
+    // CCP2 compares against Timer1 and interrupts when the next millisecond starts. The toggled
+    // output isn't routed to a pin.
+    CCPTMRS0bits.C2TSEL = 0b01;
+    CCPR2 = (uint16_t)next_ms_start;
+    CCP2CONbits.MODE = 0b0010;
+    CCP2CONbits.EN = 1;
+    PIR4bits.CCP2IF = 0;
+    PIE4bits.CCP2IE = 1;
+
+    T1CONbits.ON = 1;
+}
+
+void timebase_handle_interrupt(void) {
+    ms_start = next_ms_start;
+    ms_count++;
+
+    uint32_t step = step_q16 + step_remainder;
+    next_ms_start += step >> 16;
+    step_remainder = step & 0xffff;
+    CCPR2 = (uint16_t)next_ms_start;
+}
+
+uint32_t millis(void) {
+    // Four bytes the interrupt can change half way through reading
+    uint32_t ms;
+    do {
+        ms = ms_count;
+    } while (ms != ms_count);
+    return ms;
+}
+
+uint32_t micros(void) {
+    uint32_t ms;
+    uint16_t start;
+    uint16_t now;
+    do {
+        ms = ms_count;
+        start = (uint16_t)ms_start;
+        now = TMR1;
+    } while (ms != ms_count);
+
+    // If the next ms has started and its interrupt is pending, this runs past 1000, which is
+    // still the right time
+    return ms * 1000 + (((uint32_t)(uint16_t)(now - start) * us_per_tick_q16) >> 16);
+}
+
+void timebase_stamp(uint16_t captured, timebase_stamp_t *stamp) {
+    // Negative if the capture came before the start of this ms
+    int16_t offset = (int16_t)(captured - (uint16_t)ms_start);
+    stamp->ticks = ms_start + offset;
+
+    int32_t us = (int32_t)offset * us_per_tick_q16 / 65536;
+    uint32_t ms = ms_count;
+    while (us < 0) {
+        us += 1000;
+        ms--;
+    }
+    while (us >= 1000) {
+        us -= 1000;
+        ms++;
+    }
+    stamp->ms = ms;
+    stamp->us = (uint16_t)us;
+}
+
+// Rate from the edges in the window, which are whole seconds apart on the receiver's clock
+static void measure_frequency(void) {
+    uint8_t seconds = disc.edges - 1;
+    uint32_t span = disc.edge_ticks[disc.edges - 1] - disc.edge_ticks[0];
+
+    // Ticks per second in Q8, keeping the fraction of a tick the window resolves
+    uint32_t ticks_per_s_q8 = (span / seconds) * 256 + (span % seconds) * 256 / seconds;
+
+    // ticks per ms in Q16 is ticks_per_s_q8 * 65536 / 1000 / 256, split to stay within 32 bits
+    disc.freq_step_q16 = ticks_per_s_q8 / 125 * 32 + ticks_per_s_q8 % 125 * 32 / 125;
+
+    // (ticks_per_s - 1.5M) / 1.5M * 1e9
+    int32_t error_q8 = (int32_t)(ticks_per_s_q8 - TIMEBASE_TICKS_PER_s * 256);
+    disc.osc_error_ppb = error_q8 * 125 / 48;
+}
+
+static void handle_edge(const timebase_stamp_t *edge) {
+    // A missed edge, or one that can't be PPS, starts the measurement again
+    if (disc.edges > 0) {
+        uint32_t interval = edge->ticks - disc.edge_ticks[disc.edges - 1];
+        if (interval < MIN_EDGE_INTERVAL || interval > MAX_EDGE_INTERVAL) {
+            disc.edges = 0;
+        }
+    }
+    if (disc.edges == TIMEBASE_FREQ_WINDOW_s + 1) {
+        memmove(disc.edge_ticks, disc.edge_ticks + 1, TIMEBASE_FREQ_WINDOW_s * sizeof(uint32_t));
+        disc.edges--;
+    }
+    disc.edge_ticks[disc.edges++] = edge->ticks;
+    disc.last_edge_ms = edge->ms;
+
+    if (disc.edges >= 2) {
+        measure_frequency();
+    }
+
+    // How far the local clock is past the top of the second, in (-0.5 s, 0.5 s]
+    int32_t phase_us = (int32_t)(edge->ms % 1000) * 1000 + edge->us;
+    if (phase_us > 500000) {
+        phase_us -= 1000000;
+    }
+    disc.locked = disc.edges >= 2 && phase_us <= TIMEBASE_LOCK_us && phase_us >= -TIMEBASE_LOCK_us;
+
+    // A clock that's ahead gets longer milliseconds until the next edge
+    int32_t slew_q16 = phase_us * STEP_Q16_PER_ppm / TIMEBASE_PHASE_TIME_CONSTANT_s;
+    if (slew_q16 > TIMEBASE_MAX_SLEW_ppm * STEP_Q16_PER_ppm) {
+        slew_q16 = TIMEBASE_MAX_SLEW_ppm * STEP_Q16_PER_ppm;
+    } else if (slew_q16 < -TIMEBASE_MAX_SLEW_ppm * STEP_Q16_PER_ppm) {
+        slew_q16 = -TIMEBASE_MAX_SLEW_ppm * STEP_Q16_PER_ppm;
+    }
+    set_step(disc.freq_step_q16 + slew_q16);
+    disc.slewing = true;
+}
+
+void timebase_heartbeat(void) {
+    timebase_stamp_t edge;
+    uint8_t count = pps_last_edge(&edge);
+
+    if (count != disc.pps_count) {
+        disc.pps_count = count;
+        handle_edge(&edge);
+    } else if (disc.slewing && millis() - disc.last_edge_ms > TIMEBASE_HOLDOVER_ms) {
+        // Lost PPS, hold the last measured frequency
+        set_step(disc.freq_step_q16);
+        disc.slewing = false;
+        disc.locked = false;
+    }
+}
+
+bool timebase_locked(void) {
+    return disc.locked;
+}
+
+int32_t timebase_osc_error_ppb(void) {
+    return disc.osc_error_ppb;
+}
@@ -0,0 +1,60 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Local clock for the board, in place of rocketlib's Timer0 millis(). Timer1 counts at a nominal
+// 1.5 MHz from HFINTOSC, and CCP2 interrupts every local millisecond. Once PPS edges come in,
+// the length of that millisecond is adjusted so the clock runs at the rate of the receiver's
+// and its seconds start on the PPS edges.
+
+// Timer1 runs from Fosc/4 with a 1:8 prescaler
+#define TIMEBASE_TICKS_PER_ms 1500
+#define TIMEBASE_TICKS_PER_s 1500000UL
+
+// PPS edges further than this from the nominal 1.5M ticks apart are not a second apart, or not
+// PPS. HFINTOSC is good to 2% over temperature.
+#define TIMEBASE_MAX_OSC_ERROR_ppm 20000
+// Frequency is measured over up to this many seconds of PPS edges
+#define TIMEBASE_FREQ_WINDOW_s 8
+// The phase error at each edge is slewed out with this time constant, at no more than
+// TIMEBASE_MAX_SLEW_ppm. Slewing rather than stepping keeps millis() monotonic and free of
+// jumps, so the timeouts built on it stay honest.
+#define TIMEBASE_PHASE_TIME_CONSTANT_s 4
+#define TIMEBASE_MAX_SLEW_ppm 5000
+// Locked once the local second starts within this much of the PPS edge
+#define TIMEBASE_LOCK_us 50
+// Without an edge for this long the clock holds its last frequency, with no phase correction
+#define TIMEBASE_HOLDOVER_ms 2500
+
+// Local time of a Timer1 capture
+typedef struct {
+    uint32_t ticks; // Timer1, extended to 32 bits
+    uint32_t ms;
+    uint16_t us; // into ms
+} timebase_stamp_t;
+
+// Starts Timer1 and the millisecond interrupt
+void timebase_init(void);
+
+// Called from the interrupt handler when CCP2 matches, once every local millisecond
+void timebase_handle_interrupt(void);
+
+uint32_t millis(void);
+// Wraps around every 71 minutes
+uint32_t micros(void);
+
+// Local time at which Timer1 read captured. Interrupt context only, and the capture must be
+// within the last 20 ms.
+void timebase_stamp(uint16_t captured, timebase_stamp_t *stamp);
+
+// Disciplines the clock with any new PPS edge, called from the main loop
+void timebase_heartbeat(void);
+
+bool timebase_locked(void);
+
+// HFINTOSC's error against PPS, parts per billion. 0 until measured.
+int32_t timebase_osc_error_ppb(void);
+
+#endif /* TIMEBASE_H */
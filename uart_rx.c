@@ -0,0 +1,220 @@
+#include <xc.h>
+
+#include "timebase.h"
+#include "uart_rx.h"
+
+#define UART_RX_MASK (UART_RX_BUFFER_SIZE - 1)
+
+static uint8_t rx_buffer[UART_RX_BUFFER_SIZE];
+static volatile uint16_t rx_dropped = 0;
+static volatile uint32_t rx_bytes = 0;
+static volatile uint16_t rx_fifo_overruns = 0;
+static volatile uint16_t rx_frame_errors = 0;
+
+static void enable_error_interrupt(void) {
+    U1ERRIEbits.FERIE = 1;
+    U1ERRIEbits.RXFOIE = 1;
+    PIE3bits.U1EIE = 1;
+}
+
+void uart_rx_handle_error_interrupt(void) {
+    // FERIF is about the byte at the top of the FIFO and clears once that's read. DMA1 can get
+    // to the byte first, so with DMA some frame errors may go uncounted.
+    if (U1ERRIRbits.FERIF) {
+        rx_frame_errors++;
+    }
+    if (U1ERRIRbits.RXFOIF) {
+        rx_fifo_overruns++;
+        U1ERRIRbits.RXFOIF = 0;
+    }
+}
+
+#if UART_RX_DMA
+
+// U1RX interrupt vector number, which DMA1 uses as its start trigger
+#define DMA_TRIGGER_U1RX 0x1B
+
+// Positions in the byte stream are counted modulo 256 halves, as far as the 8-bit half counter
+// can tell them apart
+#define RX_POS_MASK ((uint16_t)(256u * UART_RX_HALF_SIZE - 1))
+
+// DMA1 is the producer and the main loop the consumer. The only state the ISR touches is the
+// count of halves filled, a single byte so reads from the main loop are atomic.
+static volatile uint8_t rx_halves = 0;
+
+// Main loop side, as positions in the received byte stream
+static uint16_t rx_consumed = 0; // next byte to parse
+static uint16_t rx_ready = 0; // end of the bytes handed over to the parser
+static uint16_t rx_written = 0; // where DMA1 was at the last look
+static uint8_t rx_handed_halves = 0;
+static uint32_t rx_last_ms = 0; // when rx_written last moved
+
+void uart_rx_init(void) {
+    rx_halves = 0;
+    rx_consumed = 0;
+    rx_ready = 0;
+    rx_written = 0;
+    rx_handed_halves = 0;
+    enable_error_interrupt();
+
+    // Move each byte from U1RXB to the next slot of the buffer, wrapping at the end
+    DMA1CON1bits.DMODE = 0b01; // destination pointer incremented
+    DMA1CON1bits.DSTP = 0; // keep going when the destination count reloads
+    DMA1CON1bits.SMR = 0b00; // source in SFR/GPR space
+    DMA1CON1bits.SMODE = 0b00; // source pointer fixed
+    DMA1CON1bits.SSTP = 0;
+    DMA1SSA = (uintptr_t)&U1RXB;
+    DMA1DSA = (uintptr_t)rx_buffer;
+    // The source count reloads, and interrupts, every half buffer
+    DMA1SSZ = UART_RX_HALF_SIZE;
+    DMA1DSZ = UART_RX_BUFFER_SIZE;
+    DMA1SIRQ = DMA_TRIGGER_U1RX;
+
+    // DMA1 needs the bus ahead of the CPU, or U1RXB can overrun while an ISR runs. Priorities only
+    // take effect once locked, and DMA doesn't run until they are. The unlock sequence must not be
+    // interrupted.
+    bool gie = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    DMA1PR = 0;
+    ISRPR = 1;
+    MAINPR = 2;
+    PRLOCK = 0x55;
+    PRLOCK = 0xAA;
+    PRLOCKbits.PRLOCKED = 1;
+    INTCON0bits.GIE = gie;
+
+    PIE2bits.DMA1SCNTIE = 1;
+    DMA1CON0bits.EN = 1;
+    DMA1CON0bits.SIRQEN = 1;
+}
+
+void uart_rx_handle_interrupt(void) {
+    rx_halves++;
+}
+
+// Position in the byte stream DMA1 has written up to
+static uint16_t dma_written(uint8_t halves) {
+    // DMA1DCNT is read a byte at a time and can change in between, so read until it's stable
+    uint16_t count;
+    do {
+        count = DMA1DCNT;
+    } while (count != DMA1DCNT);
+    uint8_t index = (uint8_t)(UART_RX_BUFFER_SIZE - count);
+
+    // Offset from the start of the half DMA1 was filling when halves was read. If DMA1 has
+    // moved on to the next half and the interrupt is still pending, this runs past the half,
+    // which still gives the right position.
+    uint8_t offset = (index - (halves & 1) * UART_RX_HALF_SIZE) & UART_RX_MASK;
+    return ((uint16_t)halves * UART_RX_HALF_SIZE + offset) & RX_POS_MASK;
+}
+
+uint16_t uart_rx_peek(const uint8_t **data) {
+    uint8_t halves = rx_halves;
+    uint16_t written = dma_written(halves);
+
+    if (written != rx_written) {
+        rx_bytes += (written - rx_written) & RX_POS_MASK;
+        rx_written = written;
+        rx_last_ms = millis();
+    }
+
+    if (((written - rx_consumed) & RX_POS_MASK) > UART_RX_BUFFER_SIZE) {
+        // DMA1 has lapped us and overwritten bytes we hadn't parsed. Start again from what's
+        // arriving now, the parser resyncs at the next message.
+        rx_dropped += (written - rx_consumed) & RX_POS_MASK;
+        rx_consumed = written;
+        rx_ready = written;
+        rx_handed_halves = halves;
+        return 0;
+    }
+
+    // Hand everything received so far to the parser once a half has filled or the line is idle
+    if (halves != rx_handed_halves || millis() - rx_last_ms >= UART_RX_IDLE_ms) {
+        rx_handed_halves = halves;
+        rx_ready = written;
+    }
+
+    uint16_t count = (rx_ready - rx_consumed) & RX_POS_MASK;
+    if (count == 0) {
+        return 0;
+    }
+
+    // Only up to the end of the buffer, the rest comes on the next call
+    uint8_t tail = rx_consumed & UART_RX_MASK;
+    if (count > UART_RX_BUFFER_SIZE - tail) {
+        count = UART_RX_BUFFER_SIZE - tail;
+    }
+    *data = &rx_buffer[tail];
+    return count;
+}
+
+void uart_rx_consume(uint16_t count) {
+    rx_consumed = (rx_consumed + count) & RX_POS_MASK;
+}
+
+#else
+
+// Single producer (UART ISR), single consumer (main loop). Each index is only
+// ever written by one side and is a single byte, so reads and writes are atomic
+// on the PIC18 and no interrupt masking is needed.
+static volatile uint8_t rx_head = 0; // next slot to write, owned by the ISR
+static volatile uint8_t rx_tail = 0; // next slot to read, owned by the main loop
+
+void uart_rx_init(void) {
+    rx_head = 0;
+    rx_tail = 0;
+    enable_error_interrupt();
+
+    // Interrupt on every received byte
+    PIE3bits.U1RXIE = 1;
+}
+
+bool uart_rx_push(uint8_t byte) {
+    uint8_t head = rx_head;
+    uint8_t next = (head + 1) & UART_RX_MASK;
+    rx_bytes++;
+
+    if (next == rx_tail) {
+        rx_dropped++;
+        return false;
+    }
+
+    rx_buffer[head] = byte;
+    // Publish the byte only after it has been written
+    rx_head = next;
+    return true;
+}
+
+uint16_t uart_rx_peek(const uint8_t **data) {
+    uint8_t head = rx_head;
+    uint8_t tail = rx_tail;
+
+    if (tail == head) {
+        return 0;
+    }
+
+    *data = &rx_buffer[tail];
+    // Only up to the end of the buffer, the rest comes on the next call
+    return head > tail ? head - tail : UART_RX_BUFFER_SIZE - tail;
+}
+
+void uart_rx_consume(uint16_t count) {
+    rx_tail = (rx_tail + count) & UART_RX_MASK;
+}
+
+#endif
+
+uint16_t uart_rx_dropped(void) {
+    return rx_dropped;
+}
+
+void uart_rx_get_stats(uart_rx_stats_t *stats) {
+    // The counts are several bytes that interrupts update
+    bool gie = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    stats->bytes = rx_bytes;
+    stats->dropped = rx_dropped;
+    stats->fifo_overruns = rx_fifo_overruns;
+    stats->frame_errors = rx_frame_errors;
+    INTCON0bits.GIE = gie;
+}
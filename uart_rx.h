@@ -0,0 +1,62 @@
+#ifndef UART_RX_H
+#define UART_RX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Receive through DMA1 straight into the buffer rather than taking an interrupt per byte. Define
+// as 0 to fall back to the interrupt-driven ring.
+#ifndef UART_RX_DMA
+#define UART_RX_DMA 1
+#endif
+
+// Must be a power of two no larger than 256 so the 8-bit indices wrap cleanly.
+// At 9600 baud this holds about a quarter second of receiver output.
+#define UART_RX_BUFFER_SIZE 256
+
+#if UART_RX_DMA
+// DMA1 interrupts after each half of the buffer fills
+#define UART_RX_HALF_SIZE (UART_RX_BUFFER_SIZE / 2)
+// A partly filled half is handed over once nothing has arrived for this long, which happens
+// after the receiver's burst of output for each epoch. A character takes 1.04 ms at 9600 baud.
+#define UART_RX_IDLE_ms 2
+#endif
+
+// Counted since boot. The 16-bit counts wrap around.
+typedef struct {
+    uint32_t bytes; // received by the UART, including any dropped
+    uint16_t dropped; // the buffer was full
+    uint16_t fifo_overruns; // U1RXB overflowed before it was read
+    uint16_t frame_errors; // no stop bit, usually a baud rate mismatch
+} uart_rx_stats_t;
+
+// Sets up reception into the buffer, called from uart_init()
+void uart_rx_init(void);
+
+// Called from the interrupt handler on a UART receive error, ahead of reading the byte
+void uart_rx_handle_error_interrupt(void);
+
+#if UART_RX_DMA
+// Called from the interrupt handler when DMA1 has filled half the buffer
+void uart_rx_handle_interrupt(void);
+#else
+// Called from the UART interrupt. Returns false (and drops the byte) if the
+// main loop has fallen a whole buffer behind.
+bool uart_rx_push(uint8_t byte);
+#endif
+
+// Called from the main loop. Returns how many received bytes are ready, contiguous from *data, or
+// 0 if there are none. With DMA, bytes are handed over once half the buffer has filled or the
+// line has gone idle, so the parser gets them in chunks. The bytes stay valid until
+// uart_rx_consume().
+uint16_t uart_rx_peek(const uint8_t **data);
+
+// Releases bytes returned by uart_rx_peek() once they've been parsed
+void uart_rx_consume(uint16_t count);
+
+// Number of bytes dropped because the buffer was full
+uint16_t uart_rx_dropped(void);
+
+void uart_rx_get_stats(uart_rx_stats_t *stats);
+
+#endif /* UART_RX_H */
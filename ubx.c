@@ -0,0 +1,258 @@
+#include <string.h>
+
+#include "gps_general.h"
+#include "gps_module.h"
+#include "pps.h"
+#include "ubx.h"
+
+typedef enum {
+    U_SYNC_1 = 0,
+    U_SYNC_2,
+    U_CLASS,
+    U_ID,
+    U_LENGTH_LOW,
+    U_LENGTH_HIGH,
+    U_PAYLOAD,
+    U_CK_A,
+    U_CK_B,
+} ubx_state;
+
+static struct {
+    ubx_state state;
+    uint8_t msg_class;
+    uint8_t msg_id;
+    uint16_t length;
+    uint16_t index;
+    uint8_t ck_a;
+    uint8_t ck_b;
+    uint8_t payload[UBX_MAX_PAYLOAD];
+} ubx;
+
+static uint16_t valid_messages = 0;
+static ubx_stats_t stats;
+
+// NAV-PVT payload offsets and flags
+#define PVT_ITOW 0
+#define PVT_HOUR 8
+#define PVT_MIN 9
+#define PVT_SEC 10
+#define PVT_NANO 16
+#define PVT_FIX_TYPE 20
+#define PVT_FLAGS 21
+#define PVT_NUM_SV 23
+#define PVT_LON 24
+#define PVT_LAT 28
+#define PVT_HMSL 36
+#define PVT_GSPEED 60
+#define PVT_HEAD_MOT 64
+
+#define PVT_FIX_TYPE_DEAD_RECKONING 1
+#define PVT_FLAGS_GNSS_FIX_OK 0x01
+#define PVT_FLAGS_DIFF_SOLN 0x02
+#define PVT_FLAGS_CARR_SOLN_SHIFT 6
+#define PVT_CARR_SOLN_FLOAT 1
+#define PVT_CARR_SOLN_FIXED 2
+
+// UBX is little endian
+static uint32_t read_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int32_t read_i32(const uint8_t *p) {
+    return (int32_t)read_u32(p);
+}
+
+// 1e-7 degrees to degrees, whole minutes and 1e-4 minutes
+static void coord_from_ubx(gps_coord_t *coord, int32_t value, char pos_dir, char neg_dir) {
+    uint32_t abs_value = value < 0 ? -(uint32_t)value : (uint32_t)value;
+    coord->dir = value < 0 ? neg_dir : pos_dir;
+
+    coord->deg = abs_value / 10000000;
+    // remainder is below 1e7, times 60 still fits
+    uint32_t dmin = (abs_value % 10000000) * 60 / 1000;
+    coord->min = dmin / 10000;
+    coord->dmin = dmin % 10000;
+}
+
+// Maps fix type and flags onto the GGA quality indicator used by the info message
+static uint8_t quality_from_ubx(uint8_t fix_type, uint8_t flags) {
+    if (!(flags & PVT_FLAGS_GNSS_FIX_OK)) {
+        return 0;
+    }
+    switch (flags >> PVT_FLAGS_CARR_SOLN_SHIFT) {
+        case PVT_CARR_SOLN_FIXED:
+            return 4;
+        case PVT_CARR_SOLN_FLOAT:
+            return 5;
+        default:
+            break;
+    }
+    if (fix_type == PVT_FIX_TYPE_DEAD_RECKONING) {
+        return 6;
+    }
+    return (flags & PVT_FLAGS_DIFF_SOLN) ? 2 : 1;
+}
+
+static void handle_nav_pvt(const uint8_t *pvt) {
+    // GPS time of week in ms. GPS and UTC seconds differ by a whole number of leap seconds, so
+    // this gives how far into the second the epoch is.
+    uint32_t tow = read_u32(pvt + PVT_ITOW);
+    uint32_t timestamp = pps_epoch_time(tow % 1000);
+    gps_fix_t fix;
+
+    fix.hour = pvt[PVT_HOUR];
+    fix.min = pvt[PVT_MIN];
+    fix.sec = pvt[PVT_SEC];
+    // nano is the signed offset from hh:mm:ss, in [-1e9, 1e9]
+    int32_t nano = read_i32(pvt + PVT_NANO);
+    fix.csec = nano > 0 ? nano / 10000000 : 0;
+
+    fix.tow = tow;
+    fix.lat_e7 = read_i32(pvt + PVT_LAT);
+    fix.lon_e7 = read_i32(pvt + PVT_LON);
+    coord_from_ubx(&fix.lat, fix.lat_e7, 'N', 'S');
+    coord_from_ubx(&fix.lon, fix.lon_e7, 'E', 'W');
+
+    // mm above mean sea level. The compact encoding is signed, but like the NMEA path the canlib
+    // message reports negative altitudes as 0.
+    int32_t hmsl = read_i32(pvt + PVT_HMSL);
+    fix.alt_dm = hmsl / 100;
+    if (hmsl < 0) {
+        hmsl = 0;
+    }
+    fix.alt = hmsl / 1000;
+    fix.calt = hmsl % 1000 / 10;
+    fix.alt_units = 'M';
+
+    fix.numsat = pvt[PVT_NUM_SV];
+    fix.quality = quality_from_ubx(pvt[PVT_FIX_TYPE], pvt[PVT_FLAGS]);
+    // NAV-PVT does not say which constellations went into the solution
+    fix.constellation = GNSS_UNKNOWN;
+
+    // mm/s and 1e-5 degrees
+    fix.speed = read_i32(pvt + PVT_GSPEED) / 10;
+    fix.course = read_i32(pvt + PVT_HEAD_MOT) / 1000;
+
+    gps_commit_position(&fix, timestamp);
+    gps_commit_velocity(&fix, timestamp);
+}
+
+static void handle_message(void) {
+    if (ubx.msg_class == UBX_CLASS_NAV && ubx.msg_id == UBX_NAV_PVT
+        && ubx.length == UBX_NAV_PVT_LEN) {
+        handle_nav_pvt(ubx.payload);
+    }
+}
+
+void ubx_reset(void) {
+    memset(&ubx, 0, sizeof(ubx));
+}
+
+static void send_byte(uint8_t byte, uint8_t *ck_a, uint8_t *ck_b) {
+    uart_write_byte(byte);
+    *ck_a += byte;
+    *ck_b += *ck_a;
+}
+
+void ubx_send(uint8_t msg_class, uint8_t msg_id, const uint8_t *payload, uint16_t length) {
+    uint8_t ck_a = 0;
+    uint8_t ck_b = 0;
+
+    uart_write_byte(UBX_SYNC_1);
+    uart_write_byte(UBX_SYNC_2);
+    send_byte(msg_class, &ck_a, &ck_b);
+    send_byte(msg_id, &ck_a, &ck_b);
+    send_byte(length & 0xff, &ck_a, &ck_b);
+    send_byte(length >> 8, &ck_a, &ck_b);
+    for (uint16_t i = 0; i < length; i++) {
+        send_byte(payload[i], &ck_a, &ck_b);
+    }
+    uart_write_byte(ck_a);
+    uart_write_byte(ck_b);
+}
+
+uint16_t ubx_valid_messages(void) {
+    return valid_messages;
+}
+
+void ubx_get_stats(ubx_stats_t *out) {
+    *out = stats;
+}
+
+void ubx_handle_byte(uint8_t byte) {
+    // 8-bit Fletcher over class, id, length and payload
+    if (ubx.state >= U_CLASS && ubx.state <= U_PAYLOAD) {
+        ubx.ck_a += byte;
+        ubx.ck_b += ubx.ck_a;
+    }
+
+    switch (ubx.state) {
+        case U_SYNC_1:
+            if (byte == UBX_SYNC_1) {
+                ubx.state = U_SYNC_2;
+            }
+            break;
+        case U_SYNC_2:
+            if (byte == UBX_SYNC_2) {
+                ubx.state = U_CLASS;
+                ubx.ck_a = 0;
+                ubx.ck_b = 0;
+            } else {
+                ubx.state = byte == UBX_SYNC_1 ? U_SYNC_2 : U_SYNC_1;
+            }
+            break;
+        case U_CLASS:
+            ubx.msg_class = byte;
+            ubx.state = U_ID;
+            break;
+        case U_ID:
+            ubx.msg_id = byte;
+            ubx.state = U_LENGTH_LOW;
+            break;
+        case U_LENGTH_LOW:
+            ubx.length = byte;
+            ubx.state = U_LENGTH_HIGH;
+            break;
+        case U_LENGTH_HIGH:
+            ubx.length |= (uint16_t)byte << 8;
+            ubx.index = 0;
+            if (ubx.length > UBX_MAX_PAYLOAD) {
+                stats.framing_errors++;
+                ubx.state = U_SYNC_1;
+                break;
+            }
+            if (ubx.msg_class == UBX_CLASS_NAV && ubx.msg_id == UBX_NAV_PVT) {
+                stats.nav_pvt++;
+            } else {
+                stats.other++;
+            }
+            ubx.state = ubx.length > 0 ? U_PAYLOAD : U_CK_A;
+            break;
+        case U_PAYLOAD:
+            ubx.payload[ubx.index] = byte;
+            if (++ubx.index == ubx.length) {
+                ubx.state = U_CK_A;
+            }
+            break;
+        case U_CK_A:
+            if (byte == ubx.ck_a) {
+                ubx.state = U_CK_B;
+            } else {
+                stats.checksum_errors++;
+                ubx.state = U_SYNC_1;
+            }
+            break;
+        case U_CK_B:
+            if (byte == ubx.ck_b) {
+                valid_messages++;
+                handle_message();
+            } else {
+                stats.checksum_errors++;
+            }
+            ubx.state = U_SYNC_1;
+            break;
+        default:
+            ubx.state = U_SYNC_1;
+            break;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef UBX_H
+#define UBX_H
+
+#include <stdint.h>
+
+#define UBX_SYNC_1 0xb5
+#define UBX_SYNC_2 0x62
+
+#define UBX_CLASS_NAV 0x01
+#define UBX_NAV_PVT 0x07
+#define UBX_NAV_PVT_LEN 92
+
+#define UBX_CLASS_CFG 0x06
+#define UBX_CFG_PRT 0x00
+#define UBX_CFG_MSG 0x01
+#define UBX_CFG_RATE 0x08
+
+// NMEA sentences are configured through CFG-MSG as class 0xF0
+#define UBX_CLASS_NMEA 0xf0
+#define UBX_NMEA_GGA 0x00
+#define UBX_NMEA_GLL 0x01
+#define UBX_NMEA_GSA 0x02
+#define UBX_NMEA_GSV 0x03
+#define UBX_NMEA_RMC 0x04
+#define UBX_NMEA_VTG 0x05
+
+// Largest payload we decode. A header giving a longer length is taken as a framing error, so a
+// corrupted header or a chance sync pair in NMEA doesn't hold up the input for up to 64 KiB.
+#define UBX_MAX_PAYLOAD UBX_NAV_PVT_LEN
+
+// Counted since boot, each wraps around
+typedef struct {
+    uint16_t nav_pvt; // framed, whether or not the checksum is good
+    uint16_t other;
+    uint16_t checksum_errors;
+    uint16_t framing_errors; // headers with a length over UBX_MAX_PAYLOAD
+} ubx_stats_t;
+
+void ubx_reset(void);
+
+// Frames and transmits a UBX message to the receiver, blocking until it is all in the UART
+void ubx_send(uint8_t msg_class, uint8_t msg_id, const uint8_t *payload, uint16_t length);
+
+// Messages received with a good checksum, of any class
+uint16_t ubx_valid_messages(void);
+
+void ubx_get_stats(ubx_stats_t *stats);
+
+// Feeds one received byte to the UBX framer. A NAV-PVT with a good checksum is published through
+// gps_commit_position() and gps_commit_velocity().
+void ubx_handle_byte(uint8_t byte);
+
+#endif /* UBX_H */